@@ -0,0 +1,473 @@
+// runs every whole-string function over generated corpora, reporting throughput, cycles and branch misses per byte.
+// Cycles and branch misses are read from perf counters where the kernel allows it, e.g. `perf_event_paranoid` <= 2,
+// otherwise cycles fall back to the time stamp counter on x86 and branch misses are left out.
+// `--json` writes one JSON object per line instead of the table, for tracking results between commits.
+// `--large` only runs the functions that don't write output, so `--size` can be over 4 GiB without the output buffers.
+// Built with `-DUNICODE_DISPATCH` the implementation is picked at runtime, `--impl NAME` overrides it,
+// and the `_short` functions show what calling through the dispatch costs on short strings.
+//
+//   cc -O2 -march=native bench/bench.c -o bench && ./bench [--json] [--large] [--size BYTES] [--repeat N]
+//   cc -O2 -DUNICODE_DISPATCH bench/bench.c -o bench && ./bench [--impl avx512|avx2|sse4.2|scalar]
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+// counters are only read on linux.
+#define PERF_COUNT_HW_CPU_CYCLES 0
+#define PERF_COUNT_HW_BRANCH_MISSES 0
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TSC
+#endif
+
+// the corpus a function is run over only makes sense for some functions, e.g. validation stops at the first error.
+#define NEEDS_ASCII 1
+#define NEEDS_VALID 2
+// functions that only read the text, which `--large` runs.
+#define READS_ONLY 4
+
+typedef struct corpus_t {
+    const char* name;
+    utf8_t* text;
+    size_t len;
+    bool ascii;
+    bool valid;
+    // the decoded text, for encoding.
+    utf32_t* codepoints;
+    size_t ncodepoints;
+    // the text in little endian utf16, for transcoding back.
+    utf16_t* utf16;
+    size_t nutf16;
+    // an exact copy of the text, for comparing.
+    utf8_t* copy;
+    // scratch space for whatever the function writes.
+    utf8_t* utf8_out;
+    utf16_t* utf16_out;
+    utf32_t* utf32_out;
+    // the text cut into short strings, and the validity bitmap and counts the batch functions write.
+    utf8_span_t* spans;
+    int64_t* offsets;
+    size_t nstrings;
+    uint8_t* bitmap;
+    size_t* counts;
+} corpus_t;
+
+typedef struct bench_t {
+    const char* name;
+    int needs;
+    // runs the function over the whole corpus once, returning something that depends on the result.
+    size_t (*run)(corpus_t* corpus);
+} bench_t;
+
+static size_t bench_validate(corpus_t* c) { return utf8_is_valid_string64(c->text, c->len); }
+static size_t bench_count(corpus_t* c) { return utf8_count64(c->text, c->len); }
+static size_t bench_ascii(corpus_t* c) { return utf8_is_7bit_ascii_string64(c->text, c->len); }
+static size_t bench_decode_string(corpus_t* c) { return utf8_decode_string(c->text, c->len, c->utf32_out, c->len).written; }
+static size_t bench_encode_string(corpus_t* c) { return utf8_encode_string(c->codepoints, c->ncodepoints, c->utf8_out, c->len).written; }
+static size_t bench_to_utf16(corpus_t* c) { return utf8_to_utf16le(c->text, c->len, c->utf16_out, c->len, true).written; }
+static size_t bench_utf16_length(corpus_t* c) { return utf8_utf16_length(c->text, c->len); }
+static size_t bench_utf32_utf8_length(corpus_t* c) { return utf32_utf8_length(c->codepoints, c->ncodepoints); }
+static size_t bench_utf16_utf8_length(corpus_t* c) { return utf16le_utf8_length(c->utf16, c->nutf16); }
+static size_t bench_replace(corpus_t* c) { return utf8_replace_malformed_tokens_copy(c->text, c->len, c->utf8_out, '?'); }
+// a character that isn't in any corpus, so the whole text is searched.
+static size_t bench_find_char(corpus_t* c) { return utf8_find_char(c->text, c->len, 0x1F9FF); }
+
+static size_t bench_decode(corpus_t* c)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < c->len; ) {
+        decoded_utf8_t decoded = utf8_decode(c->text + i, c->len - i);
+        sum += decoded.codepoint;
+        i += decoded.len;
+    }
+    return sum;
+}
+
+static size_t bench_encode(corpus_t* c)
+{
+    size_t w = 0;
+    for (size_t i = 0; i < c->ncodepoints; i++) {
+        w += utf8_encode(c->utf8_out + w, c->len - w, c->codepoints[i]);
+    }
+    return w;
+}
+
+static size_t bench_next_char(corpus_t* c)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < c->len; n++) {
+        i = utf8_next_char64(c->text, c->len, i);
+    }
+    return n;
+}
+
+static size_t bench_cmp(corpus_t* c)
+{
+    // against a copy, so the whole text is compared.
+    return (size_t)utf8_cmp(c->text, c->len, c->copy, c->len);
+}
+
+// the length of the slices the `_short` functions are called on, cut before the next character.
+#define SHORT_LEN 24
+
+static size_t short_slice(const corpus_t* c, size_t i)
+{
+    size_t end = i + SHORT_LEN < c->len ? i + SHORT_LEN : c->len;
+    while (end < c->len && utf8_is_continuation(c->text[end])) end++;
+    return end - i;
+}
+
+static size_t bench_validate_short(corpus_t* c)
+{
+    size_t valid = 0;
+    for (size_t i = 0; i < c->len; ) {
+        size_t n = short_slice(c, i);
+        valid += utf8_is_valid_string64(c->text + i, n);
+        i += n;
+    }
+    return valid;
+}
+
+static size_t bench_count_short(corpus_t* c)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < c->len; ) {
+        size_t n = short_slice(c, i);
+        count += utf8_count64(c->text + i, n);
+        i += n;
+    }
+    return count;
+}
+
+// validates and counts every short string, the same work as `validate_short` and `count_short` together.
+static size_t bench_validate_batch(corpus_t* c) { return utf8_validate_batch(c->spans, c->nstrings, c->bitmap, c->counts) + c->counts[0]; }
+static size_t bench_validate_offsets(corpus_t* c) { return utf8_validate_offsets64(c->text, c->offsets, c->nstrings, c->bitmap, c->counts) + c->counts[0]; }
+
+static const bench_t benches[] = {
+    { "is_valid_string",   NEEDS_VALID | READS_ONLY, bench_validate },
+    { "count",             READS_ONLY,               bench_count },
+    { "is_7bit_ascii",     NEEDS_ASCII | READS_ONLY, bench_ascii },
+    { "decode_loop",       READS_ONLY,               bench_decode },
+    { "next_char_loop",    READS_ONLY,               bench_next_char },
+    { "encode_loop",       0,                        bench_encode },
+    { "decode_string",     0,                        bench_decode_string },
+    { "encode_string",     0,                        bench_encode_string },
+    { "to_utf16le",        0,                        bench_to_utf16 },
+    { "replace_malformed", 0,                        bench_replace },
+    { "find_char",         READS_ONLY,               bench_find_char },
+    { "cmp",               0,                        bench_cmp },
+    { "validate_short",    READS_ONLY,               bench_validate_short },
+    { "count_short",       READS_ONLY,               bench_count_short },
+    { "validate_batch",    0,                        bench_validate_batch },
+    { "validate_offsets",  0,                        bench_validate_offsets },
+    { "utf16_length",      READS_ONLY,               bench_utf16_length },
+    { "utf32_utf8_length", 0,                        bench_utf32_utf8_length },
+    { "utf16_utf8_length", 0,                        bench_utf16_utf8_length },
+};
+
+// words for each corpus, picked pseudo randomly so the branch predictor can't learn the character lengths.
+static const char* corpus_words[][8] = {
+    { "ascii",    "the quick brown fox ", "jumps over ", "the lazy dog. ", "0123456789 ", "Hello, World! ", 0 },
+    { "latin1",   "café ", "naïve ", "über ", "façade ", "señor ", "the ", "and " },
+    { "cyrillic", "Съешь ", "же ", "ещё ", "этих ", "мягких ", "французских ", "булок " },
+    { "cjk",      "天地玄黄", "宇宙洪荒", "日月盈昃", "辰宿列张", "寒来暑往", "秋收冬藏", 0 },
+    { "emoji",    "😂", "🤨", "🧐", "🥸", "🙂", "🥳 ", "📅" },
+    { "mixed",    "hello ", "Съешь же ", "天地玄黄 ", "😂🤨 ", "ñ÷ùþ©®« ", "𐰏𐰖 ", 0 },
+    // mixed text with a few percent of its bytes made invalid.
+    { "invalid",  "hello ", "Съешь же ", "天地玄黄 ", "😂🤨 ", "ñ÷ùþ©®« ", "𐰏𐰖 ", 0 },
+};
+
+#define NCORPORA (sizeof(corpus_words) / sizeof(corpus_words[0]))
+
+static void corpus_generate(corpus_t* corpus, const char* const* words, size_t size)
+{
+    size_t nwords = 1;
+    while (nwords < 7 && words[nwords + 1]) nwords++;
+
+    uint32_t seed = 1;
+    size_t len = 0;
+    for (;;) {
+        seed = seed * 1103515245 + 12345;
+        const char* word = words[1 + (seed >> 16) % nwords];
+        size_t word_len = strlen(word);
+        if (len + word_len > size) break;
+        memcpy(corpus->text + len, word, word_len);
+        len += word_len;
+    }
+
+    if (strcmp(words[0], "invalid") == 0) {
+        const utf8_t invalid[] = { 0x80, 0xBF, 0xC0, 0xE0, 0xE4, 0xF8, 0xFF };
+        for (size_t i = 0; i < len; i++) {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % 100 < 3) {
+                corpus->text[i] = invalid[(seed >> 8) % sizeof(invalid)];
+            }
+        }
+    }
+
+    corpus->name = words[0];
+    corpus->len = len;
+    corpus->ascii = utf8_is_7bit_ascii_string64(corpus->text, len);
+    corpus->valid = utf8_is_valid_string64(corpus->text, len);
+    // only allocated when the functions that write output are run.
+    if (corpus->codepoints) {
+        corpus->ncodepoints = utf8_decode_string(corpus->text, len, corpus->codepoints, len).written;
+        corpus->nutf16 = utf8_to_utf16le(corpus->text, len, corpus->utf16, len, true).written;
+        memcpy(corpus->copy, corpus->text, len);
+        corpus->nstrings = 0;
+        corpus->offsets[0] = 0;
+        for (size_t i = 0; i < len; corpus->nstrings++) {
+            size_t n = short_slice(corpus, i);
+            corpus->spans[corpus->nstrings] = (utf8_span_t){ corpus->text + i, n };
+            i += n;
+            corpus->offsets[corpus->nstrings + 1] = (int64_t)i;
+        }
+    } else {
+        corpus->ncodepoints = utf8_count64(corpus->text, len);
+    }
+}
+
+typedef struct counters_t {
+    int cycles;
+    int branch_misses;
+} counters_t;
+
+static int counter_open(uint64_t config)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)config;
+    return -1;
+#endif
+}
+
+static long long counter_read(int fd)
+{
+    long long count = -1;
+#ifdef __linux__
+    if (fd >= 0 && read(fd, &count, sizeof(count)) != sizeof(count)) {
+        count = -1;
+    }
+#else
+    (void)fd;
+#endif
+    return count;
+}
+
+static void counter_close(int fd)
+{
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#else
+    (void)fd;
+#endif
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static uint64_t ticks(void)
+{
+#ifdef BENCH_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+typedef struct result_t {
+    double seconds;
+    // per byte, negative when unavailable.
+    double cycles;
+    double branch_misses;
+    const char* cycle_source;
+    size_t checksum;
+} result_t;
+
+// runs the function `repeat` times, keeping the fastest pass so other load on the machine doesn't count.
+// Counters are averaged over every pass, since they can't be read around one pass without skewing short ones.
+static result_t measure(const bench_t* bench, corpus_t* corpus, int repeat)
+{
+    counters_t counters = { counter_open(PERF_COUNT_HW_CPU_CYCLES), counter_open(PERF_COUNT_HW_BRANCH_MISSES) };
+    long long start_cycles = counter_read(counters.cycles);
+    long long start_misses = counter_read(counters.branch_misses);
+
+    result_t result = { 1e30, -1, -1, "none", 0 };
+    uint64_t best_ticks = UINT64_MAX;
+    for (int r = 0; r < repeat; r++) {
+        double start = now();
+        uint64_t start_ticks = ticks();
+        result.checksum += bench->run(corpus);
+        uint64_t elapsed_ticks = ticks() - start_ticks;
+        double elapsed = now() - start;
+        result.seconds = elapsed < result.seconds ? elapsed : result.seconds;
+        best_ticks = elapsed_ticks < best_ticks ? elapsed_ticks : best_ticks;
+    }
+
+    double per_byte = 1.0 / ((double)corpus->len * repeat);
+    if (counters.cycles >= 0) {
+        result.cycles = (counter_read(counters.cycles) - start_cycles) * per_byte;
+        result.cycle_source = "perf";
+    }
+#ifdef BENCH_TSC
+    else {
+        result.cycles = (double)best_ticks / corpus->len;
+        result.cycle_source = "tsc";
+    }
+#else
+    (void)best_ticks;
+#endif
+    if (counters.branch_misses >= 0) {
+        result.branch_misses = (counter_read(counters.branch_misses) - start_misses) * per_byte;
+    }
+    counter_close(counters.cycles);
+    counter_close(counters.branch_misses);
+    return result;
+}
+
+static void print_table_row(const bench_t* bench, const corpus_t* corpus, const result_t* result)
+{
+    printf("  %-18s %-9s %8.3f GB/s", bench->name, corpus->name, (double)corpus->len / result->seconds * 1e-9);
+    if (result->cycles >= 0) {
+        printf(" %7.3f cycles/byte (%s)", result->cycles, result->cycle_source);
+    } else {
+        printf("       n/a cycles/byte       ");
+    }
+    if (result->branch_misses >= 0) {
+        printf(" %8.5f branch misses/byte\n", result->branch_misses);
+    } else {
+        printf("      n/a branch misses/byte\n");
+    }
+}
+
+static void print_json_row(const bench_t* bench, const corpus_t* corpus, const result_t* result)
+{
+    printf("{\"function\": \"%s\", \"corpus\": \"%s\", \"implementation\": \"%s\", \"bytes\": %zu, \"seconds\": %.9f, \"gb_per_s\": %.6f, ",
+           bench->name, corpus->name, utf8_active_implementation(), corpus->len, result->seconds, (double)corpus->len / result->seconds * 1e-9);
+    if (result->cycles >= 0) {
+        printf("\"cycles_per_byte\": %.6f, \"cycle_source\": \"%s\", ", result->cycles, result->cycle_source);
+    } else {
+        printf("\"cycles_per_byte\": null, \"cycle_source\": null, ");
+    }
+    if (result->branch_misses >= 0) {
+        printf("\"branch_misses_per_byte\": %.8f}\n", result->branch_misses);
+    } else {
+        printf("\"branch_misses_per_byte\": null}\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    bool large = false;
+    size_t size = 1 << 22;
+    int repeat = 10;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strcmp(argv[i], "--large") == 0) {
+            large = true;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--impl") == 0 && i + 1 < argc) {
+            if (!utf8_set_implementation(argv[++i])) {
+                fprintf(stderr, "implementation %s isn't built or isn't supported by this CPU\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--large] [--size BYTES] [--repeat N] [--impl NAME]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (size < 64 || repeat < 1) {
+        fprintf(stderr, "--size must be at least 64 and --repeat at least 1\n");
+        return 1;
+    }
+
+    corpus_t corpus = { 0 };
+    corpus.text = malloc(size);
+    if (!large) {
+        corpus.codepoints = malloc(size * sizeof(utf32_t));
+        corpus.utf16 = malloc(size * sizeof(utf16_t));
+        corpus.copy = malloc(size);
+        corpus.utf8_out = malloc(size);
+        corpus.utf16_out = malloc(size * sizeof(utf16_t));
+        corpus.utf32_out = malloc(size * sizeof(utf32_t));
+        // every short string but the last is at least `SHORT_LEN` bytes.
+        size_t max_strings = size / SHORT_LEN + 1;
+        corpus.spans = malloc(max_strings * sizeof(utf8_span_t));
+        corpus.offsets = malloc((max_strings + 1) * sizeof(int64_t));
+        corpus.bitmap = malloc(max_strings / 8 + 1);
+        corpus.counts = malloc(max_strings * sizeof(size_t));
+    }
+    if (!corpus.text || (!large && (!corpus.codepoints || !corpus.utf16 || !corpus.copy || !corpus.utf8_out || !corpus.utf16_out || !corpus.utf32_out ||
+                                    !corpus.spans || !corpus.offsets || !corpus.bitmap || !corpus.counts))) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    if (!json) {
+        printf("implementation: %s\n", utf8_active_implementation());
+    }
+
+    size_t checksum = 0;
+    for (size_t c = 0; c < NCORPORA; c++) {
+        corpus_generate(&corpus, corpus_words[c], size);
+        if (!json) {
+            printf("%s (%zu bytes, %zu characters):\n", corpus.name, corpus.len, corpus.ncodepoints);
+        }
+        for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+            if (((benches[b].needs & NEEDS_ASCII) && !corpus.ascii) || ((benches[b].needs & NEEDS_VALID) && !corpus.valid) ||
+                (large && !(benches[b].needs & READS_ONLY))) {
+                continue;
+            }
+            result_t result = measure(&benches[b], &corpus, repeat);
+            checksum += result.checksum;
+            if (json) {
+                print_json_row(&benches[b], &corpus, &result);
+            } else {
+                print_table_row(&benches[b], &corpus, &result);
+            }
+        }
+    }
+    // printed so the results can't be optimised away.
+    fprintf(stderr, "checksum %zx\n", checksum);
+
+    free(corpus.text);
+    free(corpus.codepoints);
+    free(corpus.utf16);
+    free(corpus.copy);
+    free(corpus.utf8_out);
+    free(corpus.utf16_out);
+    free(corpus.utf32_out);
+    free(corpus.spans);
+    free(corpus.offsets);
+    free(corpus.bitmap);
+    free(corpus.counts);
+}
@@ -0,0 +1,137 @@
+// compares the DFA `utf8_decode` with the `utf8_length`/`utf8_is_valid` chain it replaced,
+// decoding a character at a time through ascii, mixed-script and cjk text.
+// Branch misses are read from perf counters where the kernel allows it, e.g. `perf_event_paranoid` <= 2.
+//
+//   cc -O2 bench/decode_bench.c -o decode_bench && ./decode_bench
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define TEXT_SIZE (1 << 20)
+#define REPEAT 20
+
+// the decoder before the DFA, classifying the head byte once per check.
+decoded_utf8_t decode_chain(const utf8_t* str, size_t len)
+{
+    uint32_t utf8_len = utf8_length(str);
+    if (!utf8_is_valid(str, len)) {
+        return DECODED_UTF8_LITERAL(UNICODE_REPLACEMENT_CHAR, 1);
+    }
+    if (utf8_len == 1) {
+        return DECODED_UTF8_LITERAL(str[0], utf8_len);
+    }
+    utf32_t codepoint = str[0] & (0x7F >> utf8_len);
+    for (uint32_t i = 1; i < utf8_len; i++) {
+        codepoint = (codepoint << 6) | (str[i] & 0x3F);
+    }
+    return DECODED_UTF8_LITERAL(codepoint, utf8_len);
+}
+
+static int branch_misses_open(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static long long branch_misses_read(int fd)
+{
+    long long count = -1;
+#ifdef __linux__
+    if (fd >= 0 && read(fd, &count, sizeof(count)) != sizeof(count)) {
+        count = -1;
+    }
+#endif
+    return count;
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// decodes the text REPEAT times, keeping the fastest pass so other load on the machine doesn't count.
+static void run(const char* name, const utf8_t* text, size_t len, decoded_utf8_t (*decode)(const utf8_t*, size_t))
+{
+    int fd = branch_misses_open();
+    long long start_misses = branch_misses_read(fd);
+
+    size_t chars = 0;
+    utf32_t sum = 0;
+    double seconds = 1e30;
+    for (int r = 0; r < REPEAT; r++) {
+        double start = now();
+        chars = 0;
+        for (size_t i = 0; i < len; chars++) {
+            decoded_utf8_t decoded = decode(text + i, len - i);
+            sum += decoded.codepoint;
+            i += decoded.len;
+        }
+        double elapsed = now() - start;
+        seconds = elapsed < seconds ? elapsed : seconds;
+    }
+
+    long long misses = (branch_misses_read(fd) - start_misses) / REPEAT;
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+
+    printf("  %-6s %7.3f GB/s %7.2f ns/char", name, (double)len / seconds * 1e-9, seconds * 1e9 / chars);
+    if (fd >= 0) {
+        printf(" %7.4f branch misses/char", (double)misses / chars);
+    } else {
+        printf("  branch misses n/a");
+    }
+    printf("  (checksum %08x)\n", sum);
+}
+
+int main(void)
+{
+    static utf8_t text[TEXT_SIZE];
+    const char* corpora[][6] = {
+        { "ascii", "the quick brown fox ", "jumps over ", "the lazy dog. ", "0123456789 ", 0 },
+        { "mixed", "hello ", "Съешь же ", "天地玄黄 ", "😂🤨 ", "ñ÷ùþ©®« " },
+        { "cjk",   "天地玄黄宇宙洪荒", "日月盈昃辰宿列张", "寒来暑往秋收冬藏", 0, 0 },
+    };
+
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+        // pick words pseudo randomly so the character lengths can't be learnt by the branch predictor.
+        size_t len = 0;
+        uint32_t seed = 1;
+        size_t nwords = 1;
+        while (nwords < 5 && corpora[c][nwords + 1]) nwords++;
+        for (;;) {
+            seed = seed * 1103515245 + 12345;
+            const char* word = corpora[c][1 + (seed >> 16) % nwords];
+            size_t word_len = strlen(word);
+            if (len + word_len > TEXT_SIZE) break;
+            memcpy(text + len, word, word_len);
+            len += word_len;
+        }
+
+        printf("%s:\n", corpora[c][0]);
+        run("chain", text, len, decode_chain);
+        run("dfa", text, len, utf8_decode);
+    }
+}
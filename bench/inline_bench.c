@@ -0,0 +1,117 @@
+// times loops over a string a character at a time, calling the per-character functions from a different file
+// to the implementation, where they can only be inlined with `UNICODE_STATIC_INLINE`.
+// The same file is built as the implementation with `-DBENCH_IMPL` and as the loops without it.
+//
+//   cc -O2 -DBENCH_IMPL -c bench/inline_bench.c -o impl.o && cc -O2 bench/inline_bench.c impl.o -o calls && ./calls
+//   cc -O2 -DUNICODE_STATIC_INLINE -DBENCH_IMPL -c bench/inline_bench.c -o impl.o &&
+//   cc -O2 -DUNICODE_STATIC_INLINE bench/inline_bench.c impl.o -o inline && ./inline
+#ifdef BENCH_IMPL
+#define UNICODE_IMPL
+#include "../unicode.h"
+#else
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TEXT_SIZE (1 << 20)
+#define REPEAT 20
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static size_t decode_loop(const utf8_t* text, size_t len)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < len; ) {
+        decoded_utf8_t decoded = utf8_decode(text + i, len - i);
+        sum += decoded.codepoint;
+        i += decoded.len;
+    }
+    return sum;
+}
+
+static size_t next_char_loop(const utf8_t* text, size_t len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; n++) {
+        i = utf8_next_char64(text, len, i);
+    }
+    return n;
+}
+
+static size_t next_char_unsafe_loop(const utf8_t* text, size_t len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; n++) {
+        i = utf8_next_char_unsafe64(text, len, i);
+    }
+    return n;
+}
+
+static size_t classify_loop(const utf8_t* text, size_t len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        n += utf8_is_7bit_ascii(text[i]) + utf8_is_continuation(text[i]);
+    }
+    return n;
+}
+
+// runs the loop REPEAT times, keeping the fastest pass so other load on the machine doesn't count.
+static void run(const char* name, const utf8_t* text, size_t len, size_t chars, size_t (*loop)(const utf8_t*, size_t))
+{
+    size_t checksum = 0;
+    double seconds = 1e30;
+    for (int r = 0; r < REPEAT; r++) {
+        double start = now();
+        checksum += loop(text, len);
+        double elapsed = now() - start;
+        seconds = elapsed < seconds ? elapsed : seconds;
+    }
+    printf("  %-18s %7.3f GB/s %7.2f ns/char  (checksum %zx)\n", name, (double)len / seconds * 1e-9, seconds * 1e9 / chars, checksum);
+}
+
+int main(void)
+{
+    static utf8_t text[TEXT_SIZE];
+    const char* corpora[][6] = {
+        { "ascii", "the quick brown fox ", "jumps over ", "the lazy dog. ", "0123456789 ", 0 },
+        { "mixed", "hello ", "Съешь же ", "天地玄黄 ", "😂🤨 ", "ñ÷ùþ©®« " },
+        { "cjk",   "天地玄黄宇宙洪荒", "日月盈昃辰宿列张", "寒来暑往秋收冬藏", 0, 0 },
+    };
+
+#ifdef UNICODE_STATIC_INLINE
+    printf("static inline:\n");
+#else
+    printf("calls:\n");
+#endif
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+        // pick words pseudo randomly so the character lengths can't be learnt by the branch predictor.
+        size_t len = 0;
+        uint32_t seed = 1;
+        size_t nwords = 1;
+        while (nwords < 5 && corpora[c][nwords + 1]) nwords++;
+        for (;;) {
+            seed = seed * 1103515245 + 12345;
+            const char* word = corpora[c][1 + (seed >> 16) % nwords];
+            size_t word_len = strlen(word);
+            if (len + word_len > TEXT_SIZE) break;
+            memcpy(text + len, word, word_len);
+            len += word_len;
+        }
+        size_t chars = utf8_count64(text, len);
+
+        printf("%s:\n", corpora[c][0]);
+        run("decode", text, len, chars, decode_loop);
+        run("next_char", text, len, chars, next_char_loop);
+        run("next_char_unsafe", text, len, chars, next_char_unsafe_loop);
+        run("classify", text, len, len, classify_loop);
+    }
+}
+#endif
@@ -0,0 +1,106 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define MAX_STRINGS 2000
+
+static utf8_t data[1 << 17];
+static int32_t offsets[MAX_STRINGS + 1];
+static int64_t offsets64[MAX_STRINGS + 1];
+static utf8_span_t spans[MAX_STRINGS];
+static uint8_t valid[MAX_STRINGS / 8 + 1];
+static size_t counts[MAX_STRINGS];
+
+static uint32_t seed = 1;
+
+uint32_t next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+// every batch function agrees with checking the strings one at a time.
+void same_as_one_at_a_time(size_t n)
+{
+    size_t expected_invalid = 0;
+    for (size_t k = 0; k < n; k++) {
+        offsets64[k] = offsets[k];
+        spans[k].str = data + offsets[k];
+        spans[k].len = (size_t)(offsets[k + 1] - offsets[k]);
+        expected_invalid += !utf8_is_valid_string64(spans[k].str, spans[k].len);
+    }
+    offsets64[n] = offsets[n];
+
+    for (int version = 0; version < 3; version++) {
+        memset(valid, 0xFF, sizeof(valid));
+        memset(counts, 0xFF, sizeof(counts));
+        size_t invalid = version == 0 ? utf8_validate_offsets(data, offsets, n, valid, counts)
+                       : version == 1 ? utf8_validate_offsets64(data, offsets64, n, valid, counts)
+                       : utf8_validate_batch(spans, n, valid, counts);
+        assert(invalid == expected_invalid);
+        for (size_t k = 0; k < n; k++) {
+            bool bit = (valid[k / 8] >> (k % 8)) & 1;
+            assert(bit == utf8_is_valid_string64(spans[k].str, spans[k].len));
+            assert(counts[k] == utf8_count64(spans[k].str, spans[k].len));
+        }
+        // the rest of the last byte is cleared.
+        for (size_t k = n; k % 8 != 0; k++) {
+            assert(!((valid[k / 8] >> (k % 8)) & 1));
+        }
+        // counts are optional.
+        size_t again = version == 0 ? utf8_validate_offsets(data, offsets, n, valid, NULL)
+                     : version == 1 ? utf8_validate_offsets64(data, offsets64, n, valid, NULL)
+                     : utf8_validate_batch(spans, n, valid, NULL);
+        assert(again == invalid);
+    }
+}
+
+// valid text cut into strings of `min_len` to `max_len` bytes at any byte, so some strings cut characters in two
+// even though the buffer as a whole is valid, with `errors` malformed bytes per thousand.
+void cut_text(size_t n, size_t first, size_t min_len, size_t max_len, uint32_t errors)
+{
+    const char* words[] = { "hello ", "a", "\xC3\xA9", "\xE4\xB8\x80", "\xF0\x9F\x98\x82", "\xD0\xA1\xD1\x8A" };
+    const utf8_t malformed[] = { 0x80, 0xBF, 0xC0, 0xE0, 0xF0, 0xF4, 0xF8, 0xFF };
+    size_t len = 0;
+    while (len + 8 < sizeof(data)) {
+        const char* word = words[next_random() % 6];
+        memcpy(data + len, word, strlen(word));
+        len += strlen(word);
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (next_random() % 1000 < errors) {
+            data[i] = malformed[next_random() % sizeof(malformed)];
+        }
+    }
+
+    offsets[0] = (int32_t)first;
+    for (size_t k = 0; k < n; k++) {
+        size_t string_len = min_len + next_random() % (max_len - min_len + 1);
+        // cut on a character boundary most of the time.
+        size_t end = offsets[k] + string_len;
+        while (next_random() % 4 != 0 && end < len && utf8_is_continuation(data[end])) end++;
+        offsets[k + 1] = (int32_t)(end < len ? end : len);
+    }
+    same_as_one_at_a_time(n);
+}
+
+int main(void)
+{
+    same_as_one_at_a_time(0);
+
+    for (uint32_t errors = 0; errors <= 30; errors += 3) {
+        cut_text(MAX_STRINGS, 0, 10, 60, errors);
+        cut_text(MAX_STRINGS, 3, 0, 8, errors);
+        cut_text(200, 1, 100, 600, errors);
+        // longer than a run of the data buffer, or than `utf8_validate_batch` copies.
+        cut_text(10, 0, 4000, 9000, errors);
+        for (size_t n = 1; n < 20; n++) {
+            cut_text(n, n, 0, 70, errors);
+        }
+    }
+
+    printf("batch tests passed\n");
+}
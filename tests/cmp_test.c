@@ -0,0 +1,81 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// compares the codepoints from a `utf8_decode` loop, which `utf8_cmp` has to agree with.
+int cmp_scalar(const utf8_t* lhs, size_t lhs_len, const utf8_t* rhs, size_t rhs_len, size_t* prefix)
+{
+    size_t i = 0, j = 0;
+    *prefix = 0;
+    bool identical = true;
+    while (i < lhs_len && j < rhs_len) {
+        decoded_utf8_t l = utf8_decode(lhs + i, lhs_len - i);
+        decoded_utf8_t r = utf8_decode(rhs + j, rhs_len - j);
+        if (l.codepoint != r.codepoint) return l.codepoint < r.codepoint ? -1 : 1;
+        identical = identical && l.len == r.len && memcmp(lhs + i, rhs + j, l.len) == 0;
+        i += l.len;
+        j += r.len;
+        if (identical) *prefix = i;
+    }
+    return (i != lhs_len) - (j != rhs_len);
+}
+
+void check(const utf8_t* lhs, size_t lhs_len, const utf8_t* rhs, size_t rhs_len)
+{
+    size_t expected_prefix, prefix;
+    int expected = cmp_scalar(lhs, lhs_len, rhs, rhs_len, &expected_prefix);
+    assert(utf8_cmp(lhs, lhs_len, rhs, rhs_len) == expected);
+    assert(utf8_cmp(rhs, rhs_len, lhs, lhs_len) == -expected);
+    assert(utf8_cmp_prefix(lhs, lhs_len, rhs, rhs_len, &prefix) == expected);
+    assert(prefix == expected_prefix);
+
+    utf8_t lhs_nt[256], rhs_nt[256];
+    memcpy(lhs_nt, lhs, lhs_len);
+    memcpy(rhs_nt, rhs, rhs_len);
+    lhs_nt[lhs_len] = rhs_nt[rhs_len] = 0;
+    if (memchr(lhs, 0, lhs_len) == NULL && memchr(rhs, 0, rhs_len) == NULL) {
+        assert(utf8_cmp_nt(lhs_nt, rhs_nt) == expected);
+    }
+}
+
+int main(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖");
+    size_t len = strlen((const char*)utf8);
+
+    // every pair of prefixes, so strings end in every position of a block and of a character.
+    for (size_t i = 0; i <= len; i++) {
+        for (size_t j = 0; j <= len; j++) {
+            check(utf8, i, utf8, j);
+        }
+    }
+
+    // a single changed byte in every position, including malformed bytes and U+FFFD itself.
+    utf8_t buffer[256];
+    const utf8_t changes[] = { 0x00, 0x41, 0x7F, 0x80, 0xBF, 0xC3, 0xE0, 0xE4, 0xEF, 0xF0, 0xF4, 0xF8, 0xFF };
+    for (uint32_t c = 0; c < sizeof(changes); c++) {
+        for (size_t i = 0; i < len; i++) {
+            memcpy(buffer, utf8, len);
+            buffer[i] = changes[c];
+            check(utf8, len, buffer, len);
+            check(utf8, len, buffer, i + 1);
+        }
+    }
+
+    // malformed bytes sort as U+FFFD.
+    assert(utf8_cmp(UTF8_CAST("a\xFF"), 2, UTF8_CAST("a\xEF\xBF\xBD"), 4) == 0);
+    assert(utf8_cmp(UTF8_CAST("a\xFF" "b"), 3, UTF8_CAST("a\xEF\xBF\xBD" "c"), 5) < 0);
+    assert(utf8_cmp(UTF8_CAST("\x80"), 1, UTF8_CAST("\xF4\x8F\xBF\xBF"), 4) < 0);
+    // a truncated character is malformed, so it sorts after the whole character.
+    assert(utf8_cmp(UTF8_CAST("\xE4\xB8"), 2, UTF8_CAST("\xE4\xB8\xAD"), 3) > 0);
+    assert(utf8_cmp_nt(UTF8_CAST("\xE4\xB8"), UTF8_CAST("\xE4\xB8\xAD")) > 0);
+
+    size_t prefix;
+    assert(utf8_cmp_prefix(UTF8_CAST("ab값"), 5, UTF8_CAST("ab갌"), 5, &prefix) > 0 && prefix == 2);
+    assert(utf8_cmp_prefix(UTF8_CAST("ab"), 2, UTF8_CAST("abc"), 3, &prefix) < 0 && prefix == 2);
+
+    printf("cmp tests passed\n");
+}
@@ -0,0 +1,97 @@
+// checks `utf8::codepoint_view` and `utf8::validated_utf8` against the C decoding functions.
+//
+//   c++ -std=c++20 -O2 tests/codepoint_view_test.cpp -o codepoint_view_test && ./codepoint_view_test
+#define UNICODE_IMPL
+#include "../utf8.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <ranges>
+
+static_assert(std::bidirectional_iterator<utf8::codepoint_iterator<false>>);
+static_assert(std::bidirectional_iterator<utf8::codepoint_iterator<true>>);
+static_assert(std::ranges::bidirectional_range<utf8::codepoint_view>);
+static_assert(std::ranges::borrowed_range<utf8::valid_codepoint_view>);
+static_assert(std::ranges::view<utf8::valid_codepoint_view>);
+// the unchecked iterator is just a pointer.
+static_assert(sizeof(utf8::codepoint_iterator<true>) == sizeof(const utf8_t*));
+
+// a validated string can't be made without validating it.
+static_assert(!std::is_constructible_v<utf8::validated_utf8, const utf8_t*, size_t>);
+static_assert(!std::is_convertible_v<std::string_view, utf8::validated_utf8>);
+
+constexpr size_t count_literal() {
+    using namespace utf8::literals;
+    utf8::validated_utf8 text = "天地玄黄 h\xC3\xA9llo"_utf8;
+    return static_cast<size_t>(std::ranges::distance(text.codepoints()));
+}
+static_assert(count_literal() == 10);
+
+constexpr bool validate_at_compile_time() {
+    const utf8_t bad[] = { 'a', 0xFF };
+    const utf8_t good[] = { 'a', 0xC3, 0xA9 };
+    return !utf8::validated_utf8::validate(bad, 2) && utf8::validated_utf8::validate(good, 3)->size() == 3;
+}
+static_assert(validate_at_compile_time());
+
+// forwards like `utf8_decode`, and backwards like `utf8_prev_char`, over every prefix of the string.
+void same_as_c(const utf8_t* str, size_t len)
+{
+    utf8::codepoint_view view(str, len);
+    size_t i = 0;
+    for (auto it = view.begin(); it != view.end(); ++it) {
+        decoded_utf8_t decoded = utf8_decode(str + i, len - i);
+        assert(it.base() == str + i && *it == decoded.codepoint);
+        i += decoded.len;
+    }
+    assert(i == len);
+
+    size_t idx = len;
+    for (auto it = view.end(); it != view.begin();) {
+        --it;
+        idx = utf8_prev_char(str, len, idx);
+        assert(it.base() == str + idx);
+    }
+    assert(idx == 0 || len == 0);
+
+    std::optional<utf8::validated_utf8> validated = utf8::validated_utf8::validate(str, len);
+    assert(validated.has_value() == utf8_is_valid_string64(str, len));
+    if (validated) {
+        assert(std::ranges::equal(validated->codepoints(), view));
+        assert(std::ranges::equal(validated->codepoints() | std::views::reverse, view | std::views::reverse));
+    }
+}
+
+int main(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖");
+    size_t len = strlen((const char*)utf8);
+    for (size_t n = 0; n <= len; n++) {
+        same_as_c(utf8, n);
+    }
+
+    // malformed bytes in every position.
+    utf8_t buffer[256];
+    const utf8_t malformed[] = { 0x80, 0xBF, 0xC0, 0xE0, 0xF0, 0xF4, 0xF8, 0xFF };
+    for (utf8_t m : malformed) {
+        for (size_t i = 0; i < len; i++) {
+            memcpy(buffer, utf8, len);
+            buffer[i] = m;
+            same_as_c(buffer, len);
+        }
+    }
+
+    // with the standard algorithms.
+    std::optional<utf8::validated_utf8> text = utf8::validated_utf8::validate("h\xC3\xA9llo \xF0\x9F\x98\x82!");
+    assert(text && text->view() == "h\xC3\xA9llo \xF0\x9F\x98\x82!");
+    assert(std::ranges::count(text->codepoints(), U'l') == 2);
+    assert(std::ranges::distance(text->codepoints()) == 8);
+    assert(*std::ranges::find(text->codepoints(), 0x1F602) == 0x1F602);
+    assert(*std::ranges::prev(text->codepoints().end()) == U'!');
+    assert(!utf8::validated_utf8::validate("h\xC3llo"));
+    assert(std::ranges::count(utf8::codepoint_view("h\xC3llo"), UNICODE_REPLACEMENT_CHAR) == 1);
+
+    printf("codepoint view tests passed\n");
+}
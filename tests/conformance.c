@@ -0,0 +1,281 @@
+// checks every 1 to 4 byte sequence against a reference implementation of the rules in `utf8_is_valid`,
+// through the DFA decoder, the scalar validator, and every SIMD kernel width enabled at compile time.
+// The 2^32 inputs are split into chunks, each thread takes chunks from its own range, then steals from the others.
+// Use `--stride N` to check every Nth input for a quick run.
+//
+//   cc -O2 -march=native -pthread tests/conformance.c -o conformance && ./conformance [--threads N] [--stride N]
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define CHUNK_BITS 20
+#define NCHUNKS (1ull << (32 - CHUNK_BITS))
+#define MAX_THREADS 256
+#define MAX_REPORTS 16
+
+typedef struct oracle_t {
+    utf32_t codepoint;
+    uint32_t len;
+    bool valid;
+} oracle_t;
+
+static bool in(utf8_t byte, utf8_t low, utf8_t high) {
+    return byte >= low && byte <= high;
+}
+
+// the reference decoder, written out from the rules rather than shared with the library:
+// 00..7F and F8 are single bytes, C2..DF take 1 continuation, E1..EF take 2, F0..F4 take 3.
+// C0, C1 and E0 are always overlong, F0 must be followed by 90..9F or B0..BF, F4 by 80..8F,
+// F5..F7 are too large, other bytes can't start a character, and surrogates are accepted.
+static oracle_t oracle_decode(const utf8_t* str, size_t len)
+{
+    oracle_t error = { UNICODE_REPLACEMENT_CHAR, 1, false };
+    utf8_t b0 = str[0];
+    if (b0 < 0x80 || b0 == 0xF8) {
+        oracle_t single = { b0, 1, true };
+        return single;
+    }
+
+    uint32_t n;
+    utf8_t low = 0x80, high = 0xBF;
+    if (in(b0, 0xC2, 0xDF)) n = 2;
+    else if (in(b0, 0xE1, 0xEF)) n = 3;
+    else if (in(b0, 0xF0, 0xF4)) n = 4;
+    else return error;
+    if (b0 == 0xF4) high = 0x8F;
+    if (n > len) return error;
+
+    if (b0 == 0xF0 ? !(in(str[1], 0x90, 0x9F) || in(str[1], 0xB0, 0xBF)) : !in(str[1], low, high)) return error;
+    for (uint32_t i = 2; i < n; i++) {
+        if (!in(str[i], 0x80, 0xBF)) return error;
+    }
+
+    utf32_t codepoint = b0 & (0x7F >> n);
+    for (uint32_t i = 1; i < n; i++) {
+        codepoint = (codepoint << 6) | (str[i] & 0x3F);
+    }
+    oracle_t decoded = { codepoint, n, true };
+    return decoded;
+}
+
+static uint32_t oracle_length(utf8_t b0)
+{
+    if (b0 < 0x80) return 1;
+    if (in(b0, 0xC0, 0xDF)) return 2;
+    if (in(b0, 0xE0, 0xEF)) return 3;
+    if (in(b0, 0xF0, 0xF7)) return 4;
+    return 1;
+}
+
+// walks the string, giving the number of characters and the offset of the first error, or `len` if there isn't one.
+static uint32_t oracle_walk(const utf8_t* str, size_t len, size_t* error)
+{
+    uint32_t count = 0;
+    *error = len;
+    for (size_t i = 0; i < len; count++) {
+        oracle_t decoded = oracle_decode(str + i, len - i);
+        if (!decoded.valid && *error == len) *error = i;
+        i += decoded.len;
+    }
+    return count;
+}
+
+typedef struct worker_t {
+    _Atomic uint64_t next;
+    uint64_t end;
+    int id;
+    pthread_t thread;
+} worker_t;
+
+static worker_t workers[MAX_THREADS];
+static int nworkers;
+static uint32_t stride = 1;
+static _Atomic uint64_t chunks_done;
+static _Atomic uint64_t inputs_checked;
+static _Atomic uint64_t failures;
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void fail(uint32_t x, size_t len, const char* what)
+{
+    if (atomic_fetch_add(&failures, 1) < MAX_REPORTS) {
+        pthread_mutex_lock(&report_lock);
+        printf("FAILED %s on %02X %02X %02X %02X (len %zu)\n", what, x >> 24, (x >> 16) & 0xFF, (x >> 8) & 0xFF, x & 0xFF, len);
+        pthread_mutex_unlock(&report_lock);
+    }
+}
+
+#define CHECK(condition, what) do { if (!(condition)) fail(x, len, what); } while (0)
+
+// the bytes of `x` as a 4 byte sequence, embedded in `block` where the SIMD kernels can see it,
+// at each offset that puts a different number of its bytes either side of a block boundary.
+#define PAD 128
+
+#define CHECK_KERNELS(width, validate_blocks, count_blocks) do {                                    \
+    const size_t offsets[] = { 1, width - 3, width - 1 };                                             \
+    for (uint32_t o = 0; o < 3; o++) {                                                                \
+        memset(pad, 'a', 2 * width);                                                                  \
+        memcpy(pad + offsets[o], bytes, 4);                                                           \
+        size_t stop = validate_blocks(pad, 2 * width);                                                \
+        CHECK((stop == 2 * width) == valid, #validate_blocks);                                        \
+        size_t c = 0;                                                                                 \
+        stop = count_blocks(pad, 2 * width, &c);                                                      \
+        CHECK((stop == 2 * width) == valid && (!valid || c == 2 * width - 4 + count), #count_blocks); \
+    }                                                                                                 \
+} while (0)
+
+static void check(uint32_t x, utf8_t* pad)
+{
+    utf8_t bytes[5] = { (utf8_t)(x >> 24), (utf8_t)(x >> 16), (utf8_t)(x >> 8), (utf8_t)x, 0 };
+
+    // each shorter sequence once, as the one followed by zeros.
+    for (size_t len = 1; len <= 4; len++) {
+        if (len < 4 && (x & (0xFFFFFFFFu >> (8 * len)))) continue;
+
+        oracle_t expected = oracle_decode(bytes, len);
+        decoded_utf8_t decoded = utf8_decode(bytes, len);
+        CHECK(decoded.codepoint == expected.codepoint && decoded.len == expected.len, "utf8_decode");
+        CHECK(utf8_is_valid(bytes, len) == expected.valid, "utf8_is_valid");
+        CHECK(utf8_length(bytes) == oracle_length(bytes[0]), "utf8_length");
+
+        size_t error;
+        uint32_t count = oracle_walk(bytes, len, &error);
+        bool valid = error == len;
+        CHECK(utf8_count(bytes, len) == count, "utf8_count");
+        CHECK(utf8_is_valid_string(bytes, (uint32_t)len) == valid, "utf8_is_valid_string");
+        CHECK(utf8_is_valid_string_scalar(bytes, len) == valid, "utf8_is_valid_string_scalar");
+        utf8_validation_t result;
+        CHECK(utf8_validate_ex(bytes, len, &result) == valid && result.offset == error, "utf8_validate_ex");
+
+        if (expected.valid && bytes[0] != 0xF8) {
+            utf8_t encoded[4];
+            size_t encoded_len = utf8_encode(encoded, 4, expected.codepoint);
+            CHECK(encoded_len == expected.len && memcmp(encoded, bytes, encoded_len) == 0, "utf8_encode round trip");
+        }
+
+        if (len < 4) continue;
+
+        // the null terminated versions see the sequence up to its first null.
+        size_t nt_len = 1;
+        while (nt_len < 4 && bytes[nt_len]) nt_len++;
+        oracle_t expected_nt = bytes[0] ? oracle_decode(bytes, nt_len) : (oracle_t){ 0, 1, true };
+        decoded = utf8_decode_nt(bytes);
+        CHECK(decoded.codepoint == expected_nt.codepoint && decoded.len == expected_nt.len, "utf8_decode_nt");
+        CHECK(utf8_is_valid_nt(bytes) == expected_nt.valid, "utf8_is_valid_nt");
+
+        // the same sequence in a string of ascii, through the block kernels.
+        (void)pad;
+#ifdef UNICODE_SSE42
+        CHECK_KERNELS(16, utf8_validate_blocks_sse42, utf8_count_blocks_sse42);
+#endif
+#ifdef UNICODE_AVX2
+        CHECK_KERNELS(32, utf8_validate_blocks_avx2, utf8_count_blocks_avx2);
+#endif
+#ifdef UNICODE_AVX512
+        CHECK_KERNELS(64, utf8_validate_blocks_avx512, utf8_count_blocks_avx512);
+#endif
+        // and through the whole string functions, which restart the scalar code after the kernels.
+        memset(pad, 'a', PAD);
+        memcpy(pad + 61, bytes, 4);
+        CHECK(utf8_count(pad, PAD) == PAD - 4 + count, "utf8_count in a string");
+        CHECK(utf8_is_valid_string(pad, PAD) == valid, "utf8_is_valid_string in a string");
+        CHECK(utf8_validate_ex(pad, PAD, &result) == valid && result.offset == (valid ? PAD : 61 + error), "utf8_validate_ex in a string");
+    }
+}
+
+static bool take_chunk(worker_t* worker, uint64_t* chunk)
+{
+    uint64_t next = atomic_fetch_add(&worker->next, 1);
+    *chunk = next;
+    return next < worker->end;
+}
+
+static void run_chunk(uint64_t chunk, utf8_t* pad)
+{
+    uint64_t start = chunk << CHUNK_BITS, end = (chunk + 1) << CHUNK_BITS;
+    uint64_t n = 0;
+    for (uint64_t x = start + chunk % stride; x < end; x += stride, n++) {
+        check((uint32_t)x, pad);
+    }
+    atomic_fetch_add(&inputs_checked, n);
+    atomic_fetch_add(&chunks_done, 1);
+}
+
+static void* work(void* arg)
+{
+    worker_t* self = arg;
+    utf8_t pad[PAD];
+    uint64_t chunk;
+    while (take_chunk(self, &chunk)) {
+        run_chunk(chunk, pad);
+    }
+    // out of work, so take chunks from the others, starting with the next one along.
+    for (int k = 1; k < nworkers; k++) {
+        worker_t* victim = &workers[(self->id + k) % nworkers];
+        while (take_chunk(victim, &chunk)) {
+            run_chunk(chunk, pad);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nworkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stride") == 0 && i + 1 < argc) {
+            stride = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--threads N] [--stride N]\n", argv[0]);
+            return 1;
+        }
+    }
+    nworkers = nworkers < 1 ? 1 : nworkers > MAX_THREADS ? MAX_THREADS : nworkers;
+    stride = stride < 1 ? 1 : stride;
+
+    printf("checking every %u%s input on %d threads: oracle, dfa, scalar", stride, stride == 1 ? "st" : "th", nworkers);
+#ifdef UNICODE_SSE42
+    printf(", sse4.2");
+#endif
+#ifdef UNICODE_AVX2
+    printf(", avx2");
+#endif
+#ifdef UNICODE_AVX512
+    printf(", avx-512");
+#endif
+    printf("\n");
+
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].id = i;
+        workers[i].next = NCHUNKS * i / nworkers;
+        workers[i].end = NCHUNKS * (i + 1) / nworkers;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        pthread_create(&workers[i].thread, NULL, work, &workers[i]);
+    }
+
+    uint64_t reported = 0;
+    while (atomic_load(&chunks_done) < NCHUNKS) {
+        sleep(1);
+        uint64_t done = atomic_load(&chunks_done) * 16 / NCHUNKS;
+        if (done > reported) {
+            reported = done;
+            printf("  %3llu%%\n", (unsigned long long)(done * 100 / 16));
+            fflush(stdout);
+        }
+    }
+    for (int i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    printf("%llu inputs checked, %llu failures\n", (unsigned long long)inputs_checked, (unsigned long long)failures);
+    if (failures) return 1;
+    printf("conformance tests passed\n");
+}
@@ -0,0 +1,43 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// the one character at a time loop `utf8_count` has to agree with.
+uint32_t count_scalar(const utf8_t* str, size_t len)
+{
+    uint32_t i = 0, c = 0;
+    while (i < len) {
+        i += utf8_is_valid(&str[i], len - i) ? utf8_length(&str[i]) : 1;
+        c++;
+    }
+    return c;
+}
+
+int main(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖");
+    uint32_t len = strlen((const char*)utf8);
+    assert(utf8_count(utf8, len) == utf8_count_nt(utf8));
+    assert(utf8_count(utf8, 0) == 0);
+
+    // every prefix, so the string ends in every position of a block and of a character.
+    for (uint32_t i = 0; i <= len; i++) {
+        assert(utf8_count(utf8, i) == count_scalar(utf8, i));
+    }
+
+    // malformed bytes in every position count as one character each.
+    utf8_t buffer[256];
+    const utf8_t malformed[] = { 0x80, 0xBF, 0xC0, 0xE0, 0xF0, 0xF4, 0xF8, 0xFF };
+    for (uint32_t m = 0; m < sizeof(malformed); m++) {
+        for (uint32_t i = 0; i < len; i++) {
+            memcpy(buffer, utf8, len);
+            buffer[i] = malformed[m];
+            assert(utf8_count(buffer, len) == count_scalar(buffer, len));
+        }
+    }
+
+    printf("count tests passed\n");
+}
@@ -0,0 +1,57 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// decodes with `utf8_decode_string` and checks it against a `utf8_decode` loop.
+void check(const utf8_t* str, size_t len, size_t cap)
+{
+    utf32_t expected[512];
+    utf32_t decoded[512];
+    size_t i = 0, w = 0;
+    while (i < len && w < cap) {
+        decoded_utf8_t d = utf8_decode(str + i, len - i);
+        expected[w++] = d.codepoint;
+        i += d.len;
+    }
+
+    transcoded_t result = utf8_decode_string(str, len, decoded, cap);
+    assert(result.read == i);
+    assert(result.written == w);
+    assert(memcmp(decoded, expected, w * sizeof(utf32_t)) == 0);
+}
+
+int main(void)
+{
+    const char* strings[] = {
+        "abcdefghijklmnopqrstuvwxyz 123124567890 ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+        "Съешь же ещё этих мягких французских булок, да выпей чаю",
+        "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏闰余成岁律吕调阳",
+        "abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖",
+    };
+
+    utf8_t buffer[256];
+    const utf8_t malformed[] = { 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xF9, 0xFF };
+    for (uint32_t s = 0; s < sizeof(strings) / sizeof(strings[0]); s++) {
+        const utf8_t* utf8 = UTF8_CAST(strings[s]);
+        size_t len = strlen(strings[s]);
+
+        for (size_t i = 0; i <= len; i++) {
+            check(utf8, i, 512);
+            // running out of space part way through.
+            check(utf8, len, i);
+        }
+
+        for (uint32_t m = 0; m < sizeof(malformed); m++) {
+            for (size_t i = 0; i < len; i++) {
+                memcpy(buffer, utf8, len);
+                buffer[i] = malformed[m];
+                check(buffer, len, 512);
+            }
+        }
+    }
+
+    printf("decode string tests passed\n");
+}
@@ -0,0 +1,121 @@
+// checks every implementation picked at runtime gives the same results as the scalar one.
+//
+//   cc -O2 tests/dispatch_test.c -o dispatch_test && ./dispatch_test
+#define UNICODE_IMPL
+#ifndef UNICODE_DISPATCH
+#define UNICODE_DISPATCH
+#endif
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define LEN 3000
+
+typedef struct results_t {
+    bool valid;
+    size_t count;
+    size_t count_nt;
+    size_t found;
+    size_t replaced;
+    transcoded_t decoded, encoded, to_utf16, from_utf16;
+    utf32_t codepoints[LEN];
+    utf8_t encoded_utf8[4 * LEN];
+    utf16_t utf16[LEN];
+    utf8_t utf8[4 * LEN];
+} results_t;
+
+// a string of mixed length characters, with a malformed byte every `error_every` bytes if it isn't 0.
+size_t fill(utf8_t* buffer, size_t len, uint32_t seed, size_t error_every)
+{
+    const char* words[] = { "a", "hello ", "\xC3\xA9", "\xE4\xB8\x80", "\xF0\x9F\x98\x82" };
+    size_t i = 0;
+    for (;;) {
+        seed = seed * 1103515245 + 12345;
+        const char* word = words[(seed >> 16) % 5];
+        size_t n = strlen(word);
+        if (i + n > len) break;
+        memcpy(buffer + i, word, n);
+        i += n;
+    }
+    for (size_t k = error_every; error_every && k < i; k += error_every) {
+        buffer[k] = 0xFF;
+    }
+    buffer[i] = 0;
+    return i;
+}
+
+void run(const utf8_t* str, size_t len, results_t* r)
+{
+    static utf8_t copy[LEN + 1];
+    r->valid = utf8_is_valid_string64(str, len);
+    r->count = utf8_count64(str, len);
+    r->count_nt = utf8_count_nt64(str);
+    r->found = utf8_find_substring(str, len, UTF8_CAST("\xF0\x9F\x98\x82h"), 5);
+    memcpy(copy, str, len + 1);
+    r->replaced = utf8_replace_malformed_tokens(copy, len, '?');
+    r->decoded = utf8_decode_string(str, len, r->codepoints, LEN);
+    r->encoded = utf8_encode_string(r->codepoints, r->decoded.written, r->encoded_utf8, 4 * LEN);
+    r->to_utf16 = utf8_to_utf16le(str, len, r->utf16, LEN, true);
+    r->from_utf16 = utf16le_to_utf8(r->utf16, r->to_utf16.written, r->utf8, 4 * LEN, true);
+}
+
+bool same_transcoded(transcoded_t a, transcoded_t b)
+{
+    return a.read == b.read && a.written == b.written;
+}
+
+void same_results(const results_t* a, const results_t* b)
+{
+    assert(a->valid == b->valid);
+    assert(a->count == b->count && a->count_nt == b->count_nt);
+    assert(a->found == b->found);
+    assert(a->replaced == b->replaced);
+    assert(same_transcoded(a->decoded, b->decoded));
+    assert(memcmp(a->codepoints, b->codepoints, a->decoded.written * sizeof(utf32_t)) == 0);
+    assert(same_transcoded(a->encoded, b->encoded));
+    assert(memcmp(a->encoded_utf8, b->encoded_utf8, a->encoded.written) == 0);
+    assert(same_transcoded(a->to_utf16, b->to_utf16));
+    assert(memcmp(a->utf16, b->utf16, a->to_utf16.written * sizeof(utf16_t)) == 0);
+    assert(same_transcoded(a->from_utf16, b->from_utf16));
+    assert(memcmp(a->utf8, b->utf8, a->from_utf16.written) == 0);
+}
+
+int main(void)
+{
+    const char* names[] = { "scalar", "sse4.2", "avx2", "avx512" };
+    static utf8_t buffer[LEN + 1];
+    static results_t expected, actual;
+
+    // the widest supported implementation is picked on the first call.
+    const char* detected = utf8_active_implementation();
+    assert(utf8_set_implementation("scalar"));
+    assert(strcmp(utf8_active_implementation(), "scalar") == 0);
+    assert(!utf8_set_implementation("mmx"));
+    assert(strcmp(utf8_active_implementation(), "scalar") == 0);
+    assert(utf8_set_implementation(NULL));
+    assert(strcmp(utf8_active_implementation(), detected) == 0);
+
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+        if (!utf8_set_implementation(names[n])) {
+            printf("skipping %s, not supported\n", names[n]);
+            continue;
+        }
+        assert(strcmp(utf8_active_implementation(), names[n]) == 0);
+
+        for (uint32_t seed = 0; seed < 20; seed++) {
+            size_t error_every = seed % 4 == 0 ? 0 : 97 * seed;
+            size_t len = fill(buffer, 50 + seed * 140, seed, error_every);
+
+            utf8_set_implementation("scalar");
+            run(buffer, len, &expected);
+            utf8_set_implementation(names[n]);
+            run(buffer, len, &actual);
+            same_results(&expected, &actual);
+        }
+    }
+    utf8_set_implementation(NULL);
+
+    printf("dispatch tests passed (%s)\n", utf8_active_implementation());
+}
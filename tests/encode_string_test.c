@@ -0,0 +1,59 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// encodes with `utf8_encode_string` and checks it against a `utf8_encode` loop.
+void check(const utf32_t* codepoints, size_t n, size_t cap)
+{
+    utf8_t expected[1024];
+    utf8_t encoded[1024];
+    size_t i = 0, w = 0;
+    while (i < n) {
+        size_t len = utf8_encode(expected + w, cap - w, codepoints[i]);
+        if (len == 0 || len == UNICODE_INVALID_CODEPOINT) {
+            break;
+        }
+        w += len;
+        i++;
+    }
+
+    transcoded_t result = utf8_encode_string(codepoints, n, encoded, cap);
+    assert(result.read == i);
+    assert(result.written == w);
+    assert(memcmp(encoded, expected, w) == 0);
+}
+
+int main(void)
+{
+    // ascii, 2, 3 and 4 byte runs, then every mix of lengths.
+    utf32_t codepoints[256];
+    const utf32_t samples[] = { 0x41, 0x7F, 0x80, 0x430, 0x7FF, 0x800, 0x4E00, 0xFFFD, 0xFFFF, 0x10000, 0x1F600, 0x10FFFF };
+    const uint32_t nsamples = sizeof(samples) / sizeof(samples[0]);
+
+    for (uint32_t s = 0; s < nsamples; s++) {
+        for (uint32_t i = 0; i < 256; i++) codepoints[i] = samples[s];
+        check(codepoints, 256, 1024);
+    }
+
+    for (uint32_t x = 0; x < 20000; x++) {
+        for (uint32_t i = 0; i < 256; i++) codepoints[i] = samples[(x * 7 + i * i * 13 + (i >> (x % 5))) % nsamples];
+        check(codepoints, 256, 1024);
+        // running out of space part way through.
+        check(codepoints, 256, x % 1024);
+    }
+
+    // stops at an invalid codepoint.
+    for (uint32_t i = 0; i < 256; i++) codepoints[i] = 'a';
+    codepoints[100] = 0x110000;
+    transcoded_t result = utf8_encode_string(codepoints, 256, (utf8_t*)codepoints, 0);
+    assert(result.read == 0 && result.written == 0);
+    utf8_t buffer[256];
+    result = utf8_encode_string(codepoints, 256, buffer, sizeof(buffer));
+    assert(result.read == 100 && result.written == 100);
+    assert(!utf8_is_valid_codepoint(codepoints[result.read]));
+
+    printf("encode string tests passed\n");
+}
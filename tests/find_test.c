@@ -0,0 +1,133 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// the position by position search `utf8_find_substring` has to agree with.
+size_t find_scalar(const utf8_t* str, size_t len, const utf8_t* substr, size_t sublen)
+{
+    for (size_t i = 0; i + sublen <= len; i++) {
+        if (memcmp(str + i, substr, sublen) == 0) return i;
+    }
+    return UTF8_NOT_FOUND;
+}
+
+// finds every character of the string, from every start, with every length, through every form.
+void check_chars(const utf8_t* str, size_t len)
+{
+    for (size_t i = 0; i < len; i = utf8_next_char((utf8_t*)str, len, i)) {
+        decoded_utf8_t decoded = utf8_decode(str + i, len - i);
+        utf8_t needle[4];
+        size_t n = utf8_encode(needle, 4, decoded.codepoint);
+
+        for (size_t start = 0; start <= i; start += 7) {
+            size_t expected = find_scalar(str + start, len - start, needle, n);
+            assert(utf8_find_char(str + start, len - start, decoded.codepoint) == expected);
+            assert(utf8_find_char_nt(str + start, decoded.codepoint) == expected);
+            if (expected != UTF8_NOT_FOUND) {
+                assert(utf8_find_char_index(str + start, len - start, decoded.codepoint) == utf8_count(str + start, expected));
+            }
+        }
+        // the string ending part way through the match.
+        for (size_t end = i; end < i + n && end <= len; end++) {
+            assert(utf8_find_char(str, end, decoded.codepoint) == find_scalar(str, end, needle, n));
+        }
+    }
+}
+
+// every substring of up to 80 bytes, in a string long enough for several blocks.
+void check_substrings(const utf8_t* str, size_t len)
+{
+    utf8_t nt[256];
+    for (size_t i = 0; i < len; i += 3) {
+        for (size_t sublen = 0; sublen <= 80 && i + sublen <= len; sublen++) {
+            size_t expected = find_scalar(str, len, str + i, sublen);
+            assert(utf8_find_substring(str, len, str + i, sublen) == expected);
+
+            memcpy(nt, str + i, sublen);
+            nt[sublen] = 0;
+            assert(utf8_find_substring_nt(str, nt) == expected);
+            assert(utf8_find_substring_index(str, len, str + i, sublen) == utf8_count(str, expected));
+        }
+    }
+}
+
+int main(void)
+{
+    const char* strings[] = {
+        "abcdefghijklmnopqrstuvwxyz 123124567890 ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz",
+        "Съешь же ещё этих мягких французских булок, да выпей чаю",
+        "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏闰余成岁律吕调阳",
+        "abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖",
+    };
+
+    for (uint32_t s = 0; s < sizeof(strings) / sizeof(strings[0]); s++) {
+        const utf8_t* utf8 = UTF8_CAST(strings[s]);
+        size_t len = strlen(strings[s]);
+        check_chars(utf8, len);
+        check_substrings(utf8, len);
+    }
+
+    // characters that aren't there, and codepoints that can't be.
+    const utf8_t* utf8 = UTF8_CAST(strings[3]);
+    size_t len = strlen(strings[3]);
+    assert(utf8_find_char(utf8, len, 0x1F601) == UTF8_NOT_FOUND);
+    assert(utf8_find_char(utf8, len, 0x110000) == UTF8_NOT_FOUND);
+    assert(utf8_find_char_nt(utf8, 0x110000) == UTF8_NOT_FOUND);
+    assert(utf8_find_char_nt(utf8, 0) == UTF8_NOT_FOUND);
+    assert(utf8_find_char(UTF8_CAST("ab\0c"), 4, 0) == 2);
+    assert(utf8_find_substring(utf8, 0, utf8, 0) == 0);
+    assert(utf8_find_substring_nt(utf8, UTF8_CAST("")) == 0);
+    assert(utf8_find_substring(utf8, 3, utf8, 4) == UTF8_NOT_FOUND);
+
+    // a match found a block at a time has to be the first one, not just the first in its block.
+    utf8_t buffer[256];
+    memset(buffer, 'a', sizeof(buffer));
+    for (size_t i = 0; i + 4 <= sizeof(buffer); i++) {
+        memcpy(buffer + i, "😂", 4);
+        assert(utf8_find_char(buffer, sizeof(buffer), 0x1F602) == i);
+        assert(utf8_find_char_index(buffer, sizeof(buffer), 0x1F602) == i);
+        memcpy(buffer + i, "\xF0\xFF\xFF\x82", 4);
+        assert(utf8_find_char(buffer, sizeof(buffer), 0x1F602) == UTF8_NOT_FOUND);
+        memset(buffer + i, 'a', 4);
+    }
+
+    // invalid encodings never match the replacement character.
+    assert(utf8_find_char(UTF8_CAST("ab\xFF\x80\xE0"), 5, UNICODE_REPLACEMENT_CHAR) == UTF8_NOT_FOUND);
+    assert(utf8_find_char(UTF8_CAST("ab\xFF\xEF\xBF\xBD"), 6, UNICODE_REPLACEMENT_CHAR) == 3);
+
+    // encodings `utf8_decode` rejects aren't characters, so they're never found, like the decoded U+FFFD.
+    const utf8_t* rejected = UTF8_CAST("\xE0\xA0\x80\xF0\xA0\x80\x80");
+    assert(utf8_find_char(rejected, 7, 0x0800) == UTF8_NOT_FOUND && utf8_find_char_nt(rejected, 0x0800) == UTF8_NOT_FOUND);
+    assert(utf8_find_char(rejected, 7, 0x20000) == UTF8_NOT_FOUND && utf8_find_char_nt(rejected, 0x20000) == UTF8_NOT_FOUND);
+    assert(utf8_find_char_index(rejected, 7, 0x0FFF) == UTF8_NOT_FOUND);
+    assert(utf8_find_char_index(rejected, 7, 0x2FFFF) == UTF8_NOT_FOUND);
+    assert(utf8_find_char(rejected, 7, 0x1000) == UTF8_NOT_FOUND && utf8_find_char(UTF8_CAST("a\xE1\x80\x80"), 4, 0x1000) == 1);
+    // every codepoint is found in its own encoding exactly when that decodes back to it.
+    for (utf32_t codepoint = 1; codepoint <= 0x10FFFF; codepoint++) {
+        utf8_t encoded[4];
+        size_t n = utf8_encode(encoded, 4, codepoint);
+        decoded_utf8_t decoded = utf8_decode(encoded, n);
+        bool decodes = decoded.codepoint == codepoint && decoded.len == n;
+        assert(utf8_find_char(encoded, n, codepoint) == (decodes ? 0 : UTF8_NOT_FOUND));
+    }
+
+    // the single byte `F8` decodes as U+00F8, so it's found like the encoded character.
+    const utf8_t* f8 = UTF8_CAST("x\xF8y\xC3\xB8");
+    assert(utf8_find_char(f8, 5, 0xF8) == 1 && utf8_find_char_nt(f8, 0xF8) == 1);
+    assert(utf8_find_char_index(f8, 5, 0xF8) == 1);
+    assert(utf8_find_char(f8 + 2, 3, 0xF8) == 1 && utf8_find_char_nt(f8 + 2, 0xF8) == 1);
+    assert(utf8_find_char(UTF8_CAST("\xC3\xB8\xF8"), 3, 0xF8) == 0);
+    assert(utf8_find_char(UTF8_CAST("\xE4\xF8"), 2, 0xF8) == 1);
+    memset(buffer, 'a', sizeof(buffer));
+    for (size_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = 0xF8;
+        assert(utf8_find_char(buffer, sizeof(buffer), 0xF8) == i);
+        assert(utf8_find_char_index(buffer, sizeof(buffer), 0xF8) == i);
+        buffer[i] = 'a';
+    }
+
+    printf("find tests passed\n");
+}
@@ -0,0 +1,83 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// builds an index with every stride and checks every lookup against a `utf8_next_char` walk.
+void check(const utf8_t* str, size_t len)
+{
+    size_t offsets[1024], positions[1024];
+    size_t count = 0;
+    for (size_t i = 0; i < len; ) {
+        size_t next = utf8_next_char((utf8_t*)str, len, i);
+        next = next == UTF8_END ? len : next;
+        for (size_t b = i; b < next; b++) positions[b] = count;
+        offsets[count++] = i;
+        i = next;
+    }
+    offsets[count] = len;
+    positions[len] = count;
+
+    const size_t strides[] = { 1, 2, 3, 7, 16, 31, 64, 100, 5000 };
+    size_t checkpoints[1024];
+    for (uint32_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++) {
+        utf8_index_t index;
+        size_t cap = utf8_index_capacity(len, strides[s]);
+        assert(utf8_index_build(&index, str, len, strides[s], checkpoints, cap));
+        assert(index.count == count);
+        assert(index.n == (count + strides[s] - 1) / strides[s]);
+
+        for (size_t c = 0; c <= count; c++) {
+            assert(utf8_index_codepoint_to_byte(&index, c) == offsets[c]);
+        }
+        assert(utf8_index_codepoint_to_byte(&index, count + 1) == UTF8_NOT_FOUND);
+        for (size_t b = 0; b <= len; b++) {
+            assert(utf8_index_byte_to_codepoint(&index, b) == positions[b]);
+        }
+        assert(utf8_index_byte_to_codepoint(&index, len + 1) == UTF8_NOT_FOUND);
+
+        if (cap > 0) {
+            assert(!utf8_index_build(&index, str, len, strides[s], checkpoints, cap - 1));
+        }
+    }
+}
+
+int main(void)
+{
+    const char* strings[] = {
+        "",
+        "abcdefghijklmnopqrstuvwxyz 123124567890 ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrstuvwxyz",
+        "Съешь же ещё этих мягких французских булок, да выпей чаю",
+        "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏闰余成岁律吕调阳",
+        "abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖",
+    };
+
+    utf8_t buffer[256];
+    const utf8_t malformed[] = { 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFF };
+    for (uint32_t s = 0; s < sizeof(strings) / sizeof(strings[0]); s++) {
+        const utf8_t* utf8 = UTF8_CAST(strings[s]);
+        size_t len = strlen(strings[s]);
+        for (size_t i = 0; i <= len; i++) {
+            check(utf8, i);
+        }
+        // malformed bytes count as one character each, in every position.
+        for (uint32_t m = 0; m < sizeof(malformed); m++) {
+            for (size_t i = 0; i < len; i++) {
+                memcpy(buffer, utf8, len);
+                buffer[i] = malformed[m];
+                check(buffer, len);
+            }
+        }
+    }
+
+    assert(utf8_index_capacity(0, 16) == 0);
+    assert(utf8_index_capacity(16, 16) == 1);
+    assert(utf8_index_capacity(17, 16) == 2);
+    utf8_index_t index;
+    size_t checkpoints[1];
+    assert(!utf8_index_build(&index, UTF8_CAST("a"), 1, 0, checkpoints, 1));
+
+    printf("index tests passed\n");
+}
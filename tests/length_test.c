@@ -0,0 +1,103 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define LEN 10000
+
+static utf8_t utf8[LEN];
+static utf8_t encoded[4 * LEN];
+static utf32_t utf32[LEN];
+static utf16_t utf16[2 * LEN];
+
+static uint32_t seed = 1;
+
+uint32_t next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+// the lengths are what the lossy transcoders write, so buffers of exactly that size hold the whole string.
+void same_as_transcoded(const utf8_t* str, size_t len)
+{
+    size_t n = utf8_utf32_length(str, len);
+    transcoded_t result = utf8_decode_string(str, len, utf32, n);
+    assert(result.read == len && result.written == n);
+    assert(utf32_utf8_length(utf32, n) == utf8_encode_string(utf32, n, encoded, sizeof(encoded)).written);
+
+    n = utf8_utf16_length(str, len);
+    for (int be = 0; be < 2; be++) {
+        result = be ? utf8_to_utf16be(str, len, utf16, n, true) : utf8_to_utf16le(str, len, utf16, n, true);
+        assert(result.read == len && result.written == n);
+
+        size_t bytes = be ? utf16be_utf8_length(utf16, n) : utf16le_utf8_length(utf16, n);
+        result = be ? utf16be_to_utf8(utf16, n, encoded, bytes, true) : utf16le_to_utf8(utf16, n, encoded, bytes, true);
+        assert(result.read == n && result.written == bytes);
+    }
+}
+
+// utf16 with unpaired surrogates in every position, each written as U+FFFD.
+void unpaired_surrogates(void)
+{
+    const utf16_t units[] = { 'a', 0xE9, 0x4E00, 0xD83D, 0xDE02, 0xD800, 0xDC00, 0xDBFF, 0xDFFF, 0xFFFD };
+    for (size_t n = 0; n < 2000; n += 7) {
+        for (size_t k = 0; k < n; k++) {
+            utf16[k] = units[next_random() % (sizeof(units) / sizeof(units[0]))];
+        }
+        size_t bytes = utf16le_utf8_length(utf16, n);
+        transcoded_t result = utf16le_to_utf8(utf16, n, encoded, bytes, true);
+        assert(result.read == n && result.written == bytes);
+
+        // byte swapped, the same units read big endian.
+        for (size_t k = 0; k < n; k++) {
+            utf16[k] = (utf16_t)(utf16[k] << 8 | utf16[k] >> 8);
+        }
+        assert(utf16be_utf8_length(utf16, n) == bytes);
+    }
+}
+
+int main(void)
+{
+    const utf8_t malformed[] = { 0x80, 0xBF, 0xC0, 0xE0, 0xF0, 0xF4, 0xF8, 0xFF };
+    const char* words[] = { "hello ", "a", "\xC3\xA9", "\xE4\xB8\x80", "\xF0\x9F\x98\x82", "\xED\xA0\x80", "\xF8" };
+
+    assert(utf8_utf32_length(NULL, 0) == 0 && utf8_utf16_length(NULL, 0) == 0);
+    assert(utf32_utf8_length(NULL, 0) == 0 && utf16le_utf8_length(NULL, 0) == 0);
+
+    // codepoints past U+10FFFF are counted as U+FFFD.
+    const utf32_t codepoints[] = { 'a', 0xE9, 0x4E00, 0x1F602, 0x10FFFF, 0x110000, 0xFFFFFFFF };
+    assert(utf32_utf8_length(codepoints, 5) == 1 + 2 + 3 + 4 + 4);
+    assert(utf32_utf8_length(codepoints, 7) == 1 + 2 + 3 + 4 + 4 + 3 + 3);
+
+    for (uint32_t errors = 0; errors <= 40; errors += 4) {
+        size_t len = 0;
+        while (len + 8 < LEN) {
+            const char* word = words[next_random() % 7];
+            memcpy(utf8 + len, word, strlen(word));
+            len += strlen(word);
+        }
+        for (size_t i = 0; i < len; i++) {
+            if (next_random() % 1000 < errors) {
+                utf8[i] = malformed[next_random() % sizeof(malformed)];
+            }
+        }
+
+        // every length and alignment around the blocks, and lengths across runs.
+        for (size_t offset = 0; offset < 64; offset += 5) {
+            for (size_t n = 0; n < 300; n++) {
+                same_as_transcoded(utf8 + offset, n);
+            }
+        }
+        for (size_t n = 4000; n < 4200; n += 3) {
+            same_as_transcoded(utf8, n);
+        }
+        same_as_transcoded(utf8, len);
+    }
+
+    unpaired_surrogates();
+
+    printf("length tests passed\n");
+}
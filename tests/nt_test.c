@@ -0,0 +1,103 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __unix__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// the null terminated versions agree with the length versions over `strlen`.
+void same_as_len(const utf8_t* str)
+{
+    size_t len = strlen((const char*)str);
+    assert(utf8_is_valid_string_nt(str) == utf8_is_valid_string64(str, len));
+    assert(utf8_count_nt64(str) == utf8_count64(str, len));
+    assert(utf8_is_7bit_ascii_string_nt(str) == utf8_is_7bit_ascii_string64(str, len));
+    assert(utf8_find_char_nt(str, 0x1F602) == utf8_find_char(str, len, 0x1F602));
+    assert(utf8_find_substring_nt(str, UTF8_CAST("\xF0\x9F\x98\x82!")) == utf8_find_substring(str, len, UTF8_CAST("\xF0\x9F\x98\x82!"), 5));
+}
+
+// replacing works on a copy, so the same string can be checked again.
+void same_replacements(const utf8_t* str)
+{
+    static utf8_t a[8192], b[8192];
+    size_t len = strlen((const char*)str);
+    memcpy(a, str, len + 1);
+    memcpy(b, str, len + 1);
+    assert(utf8_replace_malformed_tokens_nt(a, '?') == utf8_replace_malformed_tokens(b, len, '?'));
+    assert(memcmp(a, b, len + 1) == 0);
+}
+
+// a string of characters long enough to cross windows, with a character cut by every window boundary.
+size_t fill(utf8_t* buffer, size_t len, uint32_t seed)
+{
+    const char* words[] = { "a", "\xC3\xA9", "\xE4\xB8\x80", "\xF0\x9F\x98\x82", "\xF0\x9F\x98\x82!" };
+    size_t i = 0;
+    for (;;) {
+        seed = seed * 1103515245 + 12345;
+        const char* word = words[(seed >> 16) % 5];
+        size_t n = strlen(word);
+        if (i + n > len) break;
+        memcpy(buffer + i, word, n);
+        i += n;
+    }
+    buffer[i] = 0;
+    return i;
+}
+
+int main(void)
+{
+    static utf8_t buffer[8192];
+    const utf8_t malformed[] = { 0x80, 0xBF, 0xC0, 0xE0, 0xF0, 0xF4, 0xF8, 0xFF };
+
+    // every length and alignment around the block sizes.
+    for (size_t offset = 0; offset < 64; offset++) {
+        for (size_t len = 0; len < 200; len++) {
+            fill(buffer + offset, len, (uint32_t)len);
+            same_as_len(buffer + offset);
+            same_replacements(buffer + offset);
+        }
+    }
+
+    // long strings with an error in every position near the window boundaries.
+    for (uint32_t seed = 0; seed < 4; seed++) {
+        size_t len = fill(buffer, 7000, seed);
+        same_as_len(buffer);
+        for (size_t i = 2000; i < 2100; i++) {
+            utf8_t saved = buffer[i];
+            buffer[i] = malformed[i % sizeof(malformed)];
+            same_as_len(buffer);
+            same_replacements(buffer);
+            buffer[i] = saved;
+        }
+        // the terminator in every position near the window boundary.
+        for (size_t end = 2000; end < 2100 && end < len; end++) {
+            utf8_t saved = buffer[end];
+            buffer[end] = 0;
+            same_as_len(buffer);
+            buffer[end] = saved;
+        }
+    }
+
+#ifdef __unix__
+    // strings that end right before an unreadable page, the scans must not read into it.
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    utf8_t* pages = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(pages != MAP_FAILED);
+    assert(mprotect(pages + page, page, PROT_NONE) == 0);
+    for (size_t len = 0; len < 300; len++) {
+        utf8_t* str = pages + page - len - 1;
+        // bytes after the string are left as zero, from the mapping.
+        fill(str, len, (uint32_t)len);
+        same_as_len(str);
+    }
+    munmap(pages, 2 * page);
+#endif
+
+    printf("nt tests passed\n");
+}
@@ -0,0 +1,112 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+//   cc -O2 -pthread tests/parallel_test.c -o parallel_test
+
+struct call {
+    void (*task)(void* job, size_t chunk);
+    void* job;
+    size_t chunk;
+};
+
+static void* run_one(void* arg)
+{
+    struct call* c = arg;
+    c->task(c->job, c->chunk);
+    return NULL;
+}
+
+// a pthread for each chunk.
+static void run(void* pool, void (*task)(void* job, size_t chunk), void* job, size_t nchunks)
+{
+    pthread_t threads[UTF8_PARALLEL_MAX_CHUNKS];
+    struct call calls[UTF8_PARALLEL_MAX_CHUNKS];
+    (*(size_t*)pool)++;
+    for (size_t i = 0; i < nchunks; i++) {
+        calls[i] = (struct call){ task, job, i };
+        assert(pthread_create(&threads[i], NULL, run_one, &calls[i]) == 0);
+    }
+    for (size_t i = 0; i < nchunks; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+#define TEXT_SIZE (1 << 20)
+
+static utf8_t text[TEXT_SIZE];
+static utf32_t expected[TEXT_SIZE];
+static utf32_t decoded[TEXT_SIZE];
+
+// checks every parallel function against its serial version, with the hook and without.
+void check(size_t len, size_t chunks, bool every_cap)
+{
+    size_t calls = 0;
+    utf8_parallel_t threaded = { run, &calls, chunks };
+    utf8_parallel_t serial = { NULL, NULL, chunks };
+
+    bool valid = utf8_is_valid_string(text, len);
+    size_t count = utf8_count(text, len);
+    assert(utf8_is_valid_string_parallel(text, len, &threaded) == valid);
+    assert(utf8_is_valid_string_parallel(text, len, &serial) == valid);
+    assert(utf8_count_parallel(text, len, &threaded) == count);
+    assert(utf8_count_parallel(text, len, &serial) == count);
+
+    const size_t caps[] = { len, count, count / 2, count / 3 + 1, 0 };
+    for (uint32_t c = 0; c < (every_cap ? sizeof(caps) / sizeof(caps[0]) : 1); c++) {
+        transcoded_t expected_result = utf8_decode_string(text, len, expected, caps[c]);
+        transcoded_t result = utf8_decode_string_parallel(text, len, decoded, caps[c], &threaded);
+        assert(result.read == expected_result.read && result.written == expected_result.written);
+        assert(memcmp(decoded, expected, result.written * sizeof(utf32_t)) == 0);
+    }
+    assert(chunks < 2 || len < 2 * UTF8_PARALLEL_MIN_CHUNK || calls > 0);
+}
+
+int main(void)
+{
+    const char* words[] = { "hello ", "Съешь же ", "天地玄黄 ", "😂🤨 ", "ñ÷ùþ©®« ", "𐰏𐰖 " };
+    size_t len = 0;
+    uint32_t seed = 1;
+    for (;;) {
+        seed = seed * 1103515245 + 12345;
+        const char* word = words[(seed >> 16) % 6];
+        if (len + strlen(word) > TEXT_SIZE) break;
+        memcpy(text + len, word, strlen(word));
+        len += strlen(word);
+    }
+
+    const size_t chunks[] = { 0, 1, 2, 3, 7, 16, 31, UTF8_PARALLEL_MAX_CHUNKS + 10 };
+    for (uint32_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        check(len, chunks[c], true);
+        check(len - 1, chunks[c], true);
+        check(100, chunks[c], true);
+    }
+
+    // malformed sequences across the chunk edges, where the chunks have to resync.
+    const utf8_t* malformed[] = {
+        UTF8_CAST("\x80"), UTF8_CAST("\xE4\xB8"), UTF8_CAST("\xF0\x9F\x98"), UTF8_CAST("\xF0\x80\x80\x80"),
+        UTF8_CAST("\x80\x80\x80\x80\x80"), UTF8_CAST("\xFF\xBF"),
+    };
+    for (uint32_t m = 0; m < sizeof(malformed) / sizeof(malformed[0]); m++) {
+        for (size_t n = 2; n <= 16; n *= 8) {
+            for (size_t k = 1; k < n; k++) {
+                for (size_t back = 0; back <= 4; back++) {
+                    size_t at = len / n * k - back;
+                    utf8_t saved[8];
+                    size_t mlen = strlen((const char*)malformed[m]);
+                    memcpy(saved, text + at, mlen);
+                    memcpy(text + at, malformed[m], mlen);
+                    check(len, n, false);
+                    memcpy(text + at, saved, mlen);
+                }
+            }
+        }
+    }
+
+    printf("parallel tests passed\n");
+}
@@ -0,0 +1,79 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// replaces each invalid encoding `utf8_decode` finds, one byte at a time.
+size_t replace_scalar(utf8_t* str, size_t len, utf8_t chr)
+{
+    size_t i = 0, replaced = 0;
+    while (i < len) {
+        decoded_utf8_t decoded = utf8_decode(str + i, len - i);
+        if (decoded.codepoint == UNICODE_REPLACEMENT_CHAR && decoded.len == 1) {
+            str[i] = chr;
+            replaced++;
+        }
+        i += decoded.len;
+    }
+    return replaced;
+}
+
+// checks every variant against `replace_scalar`.
+void check(const utf8_t* str, size_t len)
+{
+    utf8_t expected[256] = { 0 }, in_place[256] = { 0 }, copy[256] = { 0 };
+    memcpy(expected, str, len);
+    size_t replaced = replace_scalar(expected, len, '?');
+
+    memcpy(in_place, str, len);
+    assert(utf8_replace_malformed_tokens(in_place, len, '?') == replaced);
+    assert(memcmp(in_place, expected, len) == 0);
+
+    assert(utf8_replace_malformed_tokens_copy(str, len, copy, '?') == replaced);
+    assert(memcmp(copy, expected, len) == 0);
+
+    // stops at the first null byte.
+    memcpy(in_place, str, len);
+    in_place[len] = 0;
+    size_t nt_len = strlen((const char*)in_place);
+    memcpy(expected, str, nt_len);
+    replaced = replace_scalar(expected, nt_len, '?');
+    assert(utf8_replace_malformed_tokens_nt(in_place, '?') == replaced);
+    assert(memcmp(in_place, expected, nt_len) == 0);
+}
+
+int main(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖");
+    uint32_t len = strlen((const char*)utf8);
+
+    // valid strings are left alone.
+    utf8_t buffer[256];
+    memcpy(buffer, utf8, len);
+    assert(utf8_replace_malformed_tokens(buffer, len, '?') == 0);
+    assert(memcmp(buffer, utf8, len) == 0);
+
+    for (uint32_t i = 0; i <= len; i++) {
+        check(utf8, i);
+    }
+
+    const utf8_t malformed[] = { 0x00, 0x80, 0xBF, 0xC0, 0xE0, 0xF0, 0xF4, 0xF8, 0xFF };
+    for (uint32_t m = 0; m < sizeof(malformed); m++) {
+        for (uint32_t i = 0; i < len; i++) {
+            memcpy(buffer, utf8, len);
+            buffer[i] = malformed[m];
+            check(buffer, len);
+            buffer[len - 1 - i / 2] = malformed[m];
+            check(buffer, len);
+        }
+    }
+
+    // every byte of a malformed character is replaced, the valid character after it is kept.
+    memcpy(buffer, "a\xF0\x9F\x98" "b\xC3\xA9", 7);
+    assert(utf8_replace_malformed_tokens(buffer, 7, '?') == 3);
+    assert(memcmp(buffer, "a???b\xC3\xA9", 7) == 0);
+
+    printf("replace tests passed\n");
+}
@@ -0,0 +1,74 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__unix__) && SIZE_MAX > UINT32_MAX
+#include <sys/mman.h>
+#define LARGE_TEST
+#endif
+
+// the `size_t` versions agree with the `uint32_t` ones wherever both fit.
+void same_as_32bit(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖\xFF\x80\xE4\xB8");
+    uint32_t len = strlen((const char*)utf8);
+
+    assert(utf8_count64(utf8, len) == utf8_count(utf8, len));
+    assert(utf8_count_nt64(utf8) == utf8_count_nt(utf8));
+    assert(utf8_is_valid_string64(utf8, len) == utf8_is_valid_string(utf8, len));
+    assert(utf8_is_valid_string64(utf8, len - 4) && utf8_is_valid_string(utf8, len - 4));
+    for (uint32_t i = 0; i < len; i++) {
+        assert(utf8_is_valid64(utf8 + i, len - i) == utf8_is_valid(utf8 + i, len - i));
+        assert(utf8_next_char64(utf8, len, i) == utf8_next_char((utf8_t*)utf8, len, i));
+        assert(utf8_next_char_nt64(utf8, i) == utf8_next_char_nt((utf8_t*)utf8, i));
+        assert(utf8_next_char_unsafe64(utf8, len, i) == utf8_next_char_unsafe((utf8_t*)utf8, len, i));
+        assert(utf8_next_char_unsafe_nt64(utf8, i) == utf8_next_char_unsafe_nt((utf8_t*)utf8, i));
+    }
+    assert(utf8_next_char64(utf8, len, len) == UTF8_END);
+
+    // a non ascii byte in every position, either side of the bytes checked together.
+    utf8_t buffer[200];
+    for (uint32_t i = 0; i < sizeof(buffer); i++) {
+        memset(buffer, 'a', sizeof(buffer));
+        assert(utf8_is_7bit_ascii_string64(buffer, sizeof(buffer)));
+        buffer[i] = 0x80;
+        for (uint32_t n = 0; n <= sizeof(buffer); n += 13) {
+            assert(utf8_is_7bit_ascii_string64(buffer, n) == (n <= i));
+            assert(utf8_is_7bit_ascii_string(buffer, n) == (n <= i));
+        }
+    }
+}
+
+#ifdef LARGE_TEST
+// a string of more than 4 GiB of nulls, mapped from the zero page so it costs no memory.
+void over_4gib(void)
+{
+    size_t len = ((size_t)1 << 32) + 4096;
+    const utf8_t* str = mmap(NULL, len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (str == MAP_FAILED) {
+        printf("skipping the 4 GiB test, mmap failed\n");
+        return;
+    }
+
+    // the 32-bit count wraps, the 64-bit one doesn't.
+    assert(utf8_count64(str, len) == len);
+    assert(utf8_count(str, len) == 4096);
+    assert(utf8_is_valid_string64(str, len));
+    assert(utf8_is_7bit_ascii_string64(str, len));
+    assert(utf8_next_char64(str, len, len - 1) == len);
+    assert(utf8_next_char64(str, len, len) == UTF8_END);
+    munmap((void*)str, len);
+}
+#endif
+
+int main(void)
+{
+    same_as_32bit();
+#ifdef LARGE_TEST
+    over_4gib();
+#endif
+    printf("size tests passed\n");
+}
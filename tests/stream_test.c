@@ -0,0 +1,62 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// feeds the string in chunks of `size` bytes and checks it against validating the whole string.
+void check_chunks(const utf8_t* str, size_t len, size_t size)
+{
+    utf8_stream_validator_t stream;
+    utf8_stream_validator_init(&stream);
+    bool valid = utf8_is_valid_string(str, len);
+    for (size_t i = 0; i < len; i += size) {
+        bool fed = utf8_stream_validator_feed(&stream, str + i, i + size < len ? size : len - i);
+        // never rejects a string that is still valid.
+        assert(fed || !valid);
+    }
+    assert(utf8_stream_validator_finish(&stream) == valid);
+}
+
+int main(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖");
+    uint32_t len = strlen((const char*)utf8);
+
+    // every chunk size splits characters at every byte.
+    for (size_t size = 1; size <= len; size++) {
+        check_chunks(utf8, len, size);
+        check_chunks(utf8, len - 1, size);
+    }
+
+    utf8_t buffer[256];
+    const utf8_t malformed[] = { 0x80, 0xC0, 0xE0, 0xF0, 0xF4, 0xF5, 0xF8, 0xFF };
+    for (uint32_t m = 0; m < sizeof(malformed); m++) {
+        for (uint32_t i = 0; i < len; i++) {
+            memcpy(buffer, utf8, len);
+            buffer[i] = malformed[m];
+            for (size_t size = 1; size < 80; size += 7) {
+                check_chunks(buffer, len, size);
+            }
+        }
+    }
+
+    // a character that can't be completed is rejected before the rest of it arrives.
+    utf8_stream_validator_t stream;
+    utf8_stream_validator_init(&stream);
+    assert(utf8_stream_validator_feed(&stream, UTF8_CAST("ab\xF0"), 3));
+    assert(utf8_stream_validator_feed(&stream, UTF8_CAST("\x9F"), 1));
+    assert(!utf8_stream_validator_feed(&stream, UTF8_CAST("\x98\x41"), 2));
+    assert(!utf8_stream_validator_feed(&stream, UTF8_CAST("abc"), 3));
+    assert(!utf8_stream_validator_finish(&stream));
+
+    // empty chunks and reuse after finishing.
+    assert(utf8_stream_validator_feed(&stream, UTF8_CAST("\xF0\x9F"), 2));
+    assert(utf8_stream_validator_feed(&stream, UTF8_CAST(""), 0));
+    assert(utf8_stream_validator_feed(&stream, UTF8_CAST("\x98\x82"), 2));
+    assert(utf8_stream_validator_finish(&stream));
+    assert(utf8_stream_validator_finish(&stream));
+
+    printf("stream tests passed\n");
+}
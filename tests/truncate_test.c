@@ -0,0 +1,69 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// walks forward with `utf8_next_char`, then checks stepping back and truncating agree with every step.
+void check(utf8_t* str, size_t len)
+{
+    size_t starts[512];
+    size_t n = 0;
+    for (size_t i = 0; i < len; ) {
+        starts[n++] = i;
+        uint32_t next = utf8_next_char(str, len, i);
+        i = next == UTF8_END ? len : next;
+    }
+    starts[n] = len;
+
+    assert(utf8_prev_char(str, len, 0) == UTF8_START);
+    for (size_t k = 0; k < n; k++) {
+        assert(utf8_prev_char(str, len, starts[k + 1]) == starts[k]);
+    }
+
+    for (size_t max = 0, k = 0; max <= len + 1; max++) {
+        while (k < n && starts[k + 1] <= max) k++;
+        size_t truncated = utf8_truncate(str, len, max);
+        assert(truncated == starts[k]);
+        assert(utf8_count(str, truncated) == k);
+    }
+}
+
+int main(void)
+{
+    const char* strings[] = {
+        "abcdefghijklmnopqrstuvwxyz 123124567890",
+        "Съешь же ещё этих мягких французских булок, да выпей чаю",
+        "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏闰余成岁律吕调阳",
+        "abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖",
+    };
+
+    utf8_t buffer[256];
+    const utf8_t malformed[] = { 0x80, 0xBF, 0xC0, 0xC3, 0xE0, 0xE4, 0xF0, 0xF4, 0xF8, 0xFF };
+    for (uint32_t s = 0; s < sizeof(strings) / sizeof(strings[0]); s++) {
+        size_t len = strlen(strings[s]);
+        memcpy(buffer, strings[s], len);
+        for (size_t i = 0; i <= len; i++) {
+            check(buffer, i);
+        }
+        // malformed bytes are characters of their own, in every position.
+        for (uint32_t m = 0; m < sizeof(malformed); m++) {
+            for (size_t i = 0; i < len; i++) {
+                memcpy(buffer, strings[s], len);
+                buffer[i] = malformed[m];
+                check(buffer, len);
+            }
+        }
+    }
+
+    // a run of continuation bytes is stepped through one byte at a time.
+    memset(buffer, 0x80, sizeof(buffer));
+    assert(utf8_prev_char(buffer, sizeof(buffer), sizeof(buffer)) == sizeof(buffer) - 1);
+    assert(utf8_truncate(buffer, sizeof(buffer), 100) == 100);
+    // a character that doesn't fit is dropped, a truncated one was never a character.
+    assert(utf8_truncate(UTF8_CAST("ab\xE4\xB8\xAD"), 5, 4) == 2);
+    assert(utf8_truncate(UTF8_CAST("ab\xE4\xB8" "c"), 5, 3) == 3);
+
+    printf("truncate tests passed\n");
+}
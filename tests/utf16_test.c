@@ -0,0 +1,128 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// round trips a string through utf16 in both byte orders, at every length and capacity.
+void round_trip(const utf8_t* str, size_t len)
+{
+    utf16_t utf16[512];
+    utf8_t utf8[1024];
+    for (int be = 0; be < 2; be++) {
+        transcoded_t (*to_utf16)(const utf8_t*, size_t, utf16_t*, size_t, bool) = be ? utf8_to_utf16be : utf8_to_utf16le;
+        transcoded_t (*to_utf8)(const utf16_t*, size_t, utf8_t*, size_t, bool) = be ? utf16be_to_utf8 : utf16le_to_utf8;
+
+        transcoded_t result = to_utf16(str, len, utf16, 512, false);
+        assert(result.read == len);
+        size_t n = result.written;
+
+        result = to_utf8(utf16, n, utf8, 1024, false);
+        assert(result.read == n && result.written == len);
+        assert(memcmp(utf8, str, len) == 0);
+
+        // running out of space stops on a character boundary.
+        for (size_t cap = 0; cap < n; cap++) {
+            result = to_utf16(str, len, utf16, cap, false);
+            assert(result.written <= cap && result.written + 1 >= cap);
+            assert(result.read < len && utf8_is_valid_string(str, result.read));
+        }
+        for (size_t cap = 0; cap < len; cap++) {
+            result = to_utf8(utf16, n, utf8, cap, false);
+            assert(result.written <= cap && result.written + 3 >= cap);
+            assert(memcmp(utf8, str, result.written) == 0);
+        }
+    }
+}
+
+// transcodes into a heap buffer of exactly the length written, so writing past it is caught by address sanitizer.
+void exact_buffer(const utf8_t* str, size_t len)
+{
+    static utf16_t expected[512];
+    for (int be = 0; be < 2; be++) {
+        transcoded_t (*to_utf16)(const utf8_t*, size_t, utf16_t*, size_t, bool) = be ? utf8_to_utf16be : utf8_to_utf16le;
+        size_t n = to_utf16(str, len, expected, 512, true).written;
+        utf16_t* exact = malloc((n ? n : 1) * sizeof(utf16_t));
+        assert(exact);
+        transcoded_t result = to_utf16(str, len, exact, n, true);
+        assert(result.read == len && result.written == n);
+        assert(memcmp(exact, expected, n * sizeof(utf16_t)) == 0);
+        free(exact);
+    }
+}
+
+int main(void)
+{
+    const char* strings[] = {
+        "abcdefghijklmnopqrstuvwxyz 123124567890 ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+        "Съешь же ещё этих мягких французских булок, да выпей чаю",
+        "天地玄黄宇宙洪荒日月盈昃辰宿列张寒来暑往秋收冬藏闰余成岁律吕调阳",
+        "abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖",
+    };
+    for (uint32_t s = 0; s < sizeof(strings) / sizeof(strings[0]); s++) {
+        round_trip(UTF8_CAST(strings[s]), strlen(strings[s]));
+    }
+
+    // byte order of the code units.
+    utf16_t utf16[64];
+    const utf8_t* emoji = UTF8_CAST("a😂");
+    assert(utf8_to_utf16le(emoji, 5, utf16, 64, false).written == 3);
+    assert(memcmp(utf16, "a\0\x3D\xD8\x02\xDE", 6) == 0);
+    assert(utf8_to_utf16be(emoji, 5, utf16, 64, false).written == 3);
+    assert(memcmp(utf16, "\0a\xD8\x3D\xDE\x02", 6) == 0);
+
+    // malformed utf8 stops, or is replaced when lossy.
+    utf8_t buffer[64];
+    memset(buffer, 'a', sizeof(buffer));
+    buffer[40] = 0xFF;
+    transcoded_t result = utf8_to_utf16le(buffer, 64, utf16, 64, false);
+    assert(result.read == 40 && result.written == 40);
+    result = utf8_to_utf16le(buffer, 64, utf16, 64, true);
+    assert(result.read == 64 && result.written == 64 && utf16[40] == UNICODE_REPLACEMENT_CHAR);
+
+    // unpaired surrogates stop, or are replaced when lossy.
+    for (uint32_t i = 0; i < 64; i++) utf16[i] = 'a';
+    utf16[40] = 0xDC00;
+    result = utf16le_to_utf8(utf16, 64, buffer, 64, false);
+    assert(result.read == 40 && result.written == 40);
+    result = utf16le_to_utf8(utf16, 39, buffer, 64, false);
+    assert(result.read == 39 && result.written == 39);
+    utf8_t lossy[80];
+    result = utf16le_to_utf8(utf16, 64, lossy, 80, true);
+    assert(result.read == 64 && result.written == 66);
+    assert(utf8_decode(lossy + 40, 3).codepoint == UNICODE_REPLACEMENT_CHAR);
+    // a high surrogate at the end of the input.
+    utf16[40] = 'a';
+    utf16[63] = 0xD800;
+    result = utf16le_to_utf8(utf16, 64, buffer, 64, false);
+    assert(result.read == 63 && result.written == 63);
+
+    // a block of single unit characters with a byte above `EF`, the single byte `F8`, ending the buffer.
+    static utf8_t buffer2[300];
+    utf8_t block[32];
+    memset(block, 'a', sizeof(block));
+    for (size_t i = 0; i < 32; i++) {
+        block[i] = 0xF8;
+        for (size_t len = i + 1; len <= 32; len++) {
+            exact_buffer(block, len);
+        }
+        block[i] = 'a';
+    }
+    uint32_t seed = 1;
+    const char* words[] = { "a", "\xC3\xA9", "\xE4\xB8\x80", "\xF0\x9F\x98\x82", "\xF8", "\xFF" };
+    for (size_t len = 0; len < 300; len++) {
+        size_t i = 0;
+        for (;;) {
+            seed = seed * 1103515245 + 12345;
+            const char* word = words[(seed >> 16) % 6];
+            if (i + strlen(word) > len) break;
+            memcpy(buffer2 + i, word, strlen(word));
+            i += strlen(word);
+        }
+        exact_buffer(buffer2, i);
+    }
+
+    printf("utf16 tests passed\n");
+}
@@ -0,0 +1,90 @@
+// checks the `constexpr` functions in `utf8.hpp` against the C functions they copy, and at compile time.
+//
+//   c++ -std=c++20 -O2 tests/utf8_hpp_test.cpp -o utf8_hpp_test && ./utf8_hpp_test
+#define UNICODE_IMPL
+#include "../utf8.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static_assert(utf8::length(0xE4) == 3);
+static_assert(utf8::decode("\xE4\xB8\x80", 3).codepoint == 0x4E00);
+static_assert(utf8::decode("\xE4\xB8", 2).codepoint == UNICODE_REPLACEMENT_CHAR);
+static_assert(utf8::count("a\xE4\xB8\x80\xFF", 5) == 3);
+static_assert(utf8::is_valid_string("h\xC3\xA9llo", 6));
+static_assert(!utf8::is_valid_string("\xE0\xA0\x80", 3));
+
+constexpr utf8_t encoded_euro() {
+    utf8_t buffer[4] = {};
+    return utf8::encode(buffer, 4, 0x20AC) == 3 ? buffer[2] : 0;
+}
+static_assert(encoded_euro() == 0xAC);
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+using namespace utf8::literals;
+
+static_assert(utf8::utf8_literal<"h\xC3\xA9llo">::len == 6);
+static_assert(utf8::utf8_literal<"h\xC3\xA9llo">::count == 5);
+static_assert(decltype(u8"天地玄黄"_utf8)::count == 4);
+static_assert(decltype(""_utf8)::count == 0);
+// e.g. `utf8::utf8_literal<"\xFF">` doesn't compile.
+
+void literals(void)
+{
+    constexpr auto hello = "h\xC3\xA9llo"_utf8;
+    assert(utf8_count(hello.data(), hello.len) == hello.count);
+    assert(strcmp((const char*)hello.data(), "h\xC3\xA9llo") == 0);
+}
+#endif
+
+// every sequence of up to 3 bytes, and every 4 byte sequence from a head that can start one.
+void same_as_c(void)
+{
+    utf8_t bytes[4] = {};
+    for (uint32_t x = 0; x < (1u << 24); x++) {
+        bytes[0] = (utf8_t)(x >> 16);
+        bytes[1] = (utf8_t)(x >> 8);
+        bytes[2] = (utf8_t)x;
+        for (size_t len = 1; len <= 3; len++) {
+            decoded_utf8_t expected = utf8_decode(bytes, len);
+            decoded_utf8_t decoded = utf8::decode(bytes, len);
+            assert(decoded.codepoint == expected.codepoint && decoded.len == expected.len);
+            assert(utf8::is_valid(bytes, len) == utf8_is_valid(bytes, (uint32_t)len));
+            assert(utf8::count(bytes, len) == utf8_count(bytes, len));
+            assert(utf8::is_valid_string(bytes, len) == utf8_is_valid_string(bytes, (uint32_t)len));
+        }
+    }
+    for (uint32_t x = 0xF00000; x < (1u << 24); x++) {
+        bytes[0] = (utf8_t)(x >> 16);
+        bytes[1] = (utf8_t)(x >> 8);
+        bytes[2] = (utf8_t)x;
+        const utf8_t last[] = { 0x41, 0x80, 0xBF, 0xC0 };
+        for (utf8_t b3 : last) {
+            bytes[3] = b3;
+            decoded_utf8_t expected = utf8_decode(bytes, 4);
+            decoded_utf8_t decoded = utf8::decode(bytes, 4);
+            assert(decoded.codepoint == expected.codepoint && decoded.len == expected.len);
+            assert(utf8::is_valid_string(bytes, 4) == utf8_is_valid_string(bytes, 4));
+        }
+    }
+
+    utf8_t buffer[4], expected[4];
+    for (utf32_t codepoint = 0; codepoint < 0x110100; codepoint++) {
+        for (size_t len = 0; len <= 4; len++) {
+            size_t n = utf8::encode(buffer, len, codepoint);
+            assert(n == utf8_encode(expected, len, codepoint));
+            assert(n == 0 || n == UNICODE_INVALID_CODEPOINT || memcmp(buffer, expected, n) == 0);
+        }
+        assert(utf8::codepoint_length(codepoint) == utf8_codepoint_length(codepoint));
+    }
+}
+
+int main(void)
+{
+    same_as_c();
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+    literals();
+#endif
+    printf("utf8.hpp tests passed\n");
+}
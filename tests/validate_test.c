@@ -0,0 +1,83 @@
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// bytes that sit on either side of every rule in `utf8_is_valid`.
+static const utf8_t edges[] = {
+    0x00, 0x41, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xAF, 0xB0, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF,
+    0xE0, 0xE1, 0xED, 0xEF, 0xF0, 0xF1, 0xF4, 0xF5, 0xF7, 0xF8, 0xF9, 0xFF,
+};
+
+#define NEDGES (sizeof(edges) / sizeof(edges[0]))
+
+// every 1 to 4 byte sequence of edge bytes, at every offset across the 16, 32 and 64 byte block boundaries.
+void edge_sequences(void)
+{
+    utf8_t buffer[160];
+    for (uint32_t n = 1; n <= 4; n++) {
+        uint32_t total = 1;
+        for (uint32_t i = 0; i < n; i++) total *= NEDGES;
+
+        for (uint32_t x = 0; x < total; x++) {
+            uint32_t offset = 56 + x % 12;
+            memset(buffer, 'a', sizeof(buffer));
+            for (uint32_t i = 0, y = x; i < n; i++, y /= NEDGES) {
+                buffer[offset + i] = edges[y % NEDGES];
+            }
+            for (uint32_t len = offset + n; len <= offset + n + 70; len += 35) {
+                bool valid = utf8_is_valid_string_scalar(buffer, len);
+                assert(utf8_is_valid_string(buffer, len) == valid);
+
+                utf8_validation_t result;
+                assert(utf8_validate_ex(buffer, len, &result) == valid);
+                assert((result.error == UTF8_ERROR_NONE) == valid);
+                // everything before the error is valid, and the error is where the scalar validator stops.
+                assert(utf8_is_valid_string_scalar(buffer, result.offset));
+                assert(valid || !utf8_is_valid(buffer + result.offset, len - result.offset));
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    const utf8_t* utf8 = UTF8_CAST("abc값de%%ႢfghiႦjkl𐰋mnoႠpqrႳ가stuvႧ갌wxyz😂🤨🧐🥸🙂🥳📅ñ÷ùþ©®«¥¡#$^&*()𐰏𐰖");
+    uint32_t len = strlen((const char*)utf8);
+    assert(utf8_is_valid_string(utf8, len));
+    assert(utf8_is_valid_string(utf8, 0));
+    // truncated last character.
+    assert(!utf8_is_valid_string(utf8, len - 1));
+
+    utf8_t buffer[256];
+    for (uint32_t i = 0; i < len; i++) {
+        memcpy(buffer, utf8, len);
+        buffer[i] = 0x80;
+        assert(utf8_is_valid_string(buffer, len) == utf8_is_valid_string_scalar(buffer, len));
+        buffer[i] = 0xFF;
+        assert(!utf8_is_valid_string(buffer, len));
+    }
+
+    // the offset and kind of the first error.
+    const struct { const char* str; size_t offset; utf8_error_t error; } errors[] = {
+        { "abc", 3, UTF8_ERROR_NONE },
+        { "ab\x80" "c", 2, UTF8_ERROR_UNEXPECTED_CONTINUATION },
+        { "a\xFF\x80", 1, UTF8_ERROR_BAD_HEAD },
+        { "abc\xE4\xB8", 3, UTF8_ERROR_TRUNCATED },
+        { "ab\xE4\xB8z", 2, UTF8_ERROR_TRUNCATED },
+        { "\xC1\xBF", 0, UTF8_ERROR_OVERLONG },
+        { "a\xF0\x80\x80\x80", 1, UTF8_ERROR_OVERLONG },
+        { "ab\xF4\x90\x80\x80", 2, UTF8_ERROR_TOO_LARGE },
+    };
+    for (uint32_t i = 0; i < sizeof(errors) / sizeof(errors[0]); i++) {
+        utf8_validation_t result;
+        size_t error_len = strlen(errors[i].str);
+        assert(utf8_validate_ex(UTF8_CAST(errors[i].str), error_len, &result) == (errors[i].error == UTF8_ERROR_NONE));
+        assert(result.offset == errors[i].offset && result.error == errors[i].error);
+    }
+
+    edge_sequences();
+    printf("validate tests passed\n");
+}
@@ -0,0 +1,473 @@
+// validates, counts, sanitizes and transcodes utf8 files with the library's whole-string functions.
+// Regular files are memory mapped and handed to the library in one piece,
+// pipes are read in chunks cut at character boundaries so no character is split between two calls.
+// Timing and throughput go to stderr, so stdout only has results or converted text.
+//
+//   cc -O2 -march=native -pthread tools/utf8tool.c -o utf8tool
+//
+//   utf8tool validate [-j N] [-q] [FILE...]   prints the offset and kind of the first error in each file
+//   utf8tool count [-j N] [-q] [FILE...]      prints the number of characters in each file
+//   utf8tool sanitize [-r CHAR] [-q] [FILE]   writes the file with each malformed byte replaced by CHAR, `?` by default
+//   utf8tool transcode [-f ENCODING] -t ENCODING [--strict] [-q] [FILE]
+//                                            converts the file between utf8 and utf16le, utf16be or utf32 (native byte order),
+//                                            one side has to be utf8 and `-f` is utf8 by default.
+//                                            malformed bytes, unpaired surrogates and codepoints over U+10FFFF
+//                                            become U+FFFD unless `--strict` stops at the first one
+//
+// With no FILE, or `-`, standard input is read. Exits with 1 if a file is invalid, and 2 on usage or io errors.
+#define UNICODE_IMPL
+#include "../unicode.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// bytes read from a pipe at a time, and the size of the transcoding output buffer in code units.
+#define CHUNK_SIZE (1 << 20)
+
+typedef enum command_t { VALIDATE, COUNT, SANITIZE, TRANSCODE } command_t;
+typedef enum encoding_t { UTF8, UTF16LE, UTF16BE, UTF32 } encoding_t;
+
+typedef struct options_t {
+    command_t command;
+    // what `transcode` converts from and to.
+    encoding_t from;
+    encoding_t to;
+    bool strict;
+    bool quiet;
+    utf8_t replacement;
+    size_t threads;
+} options_t;
+
+// a file being read as spans that each end on a character boundary.
+typedef struct input_t {
+    const char* name;
+    encoding_t encoding;
+    int fd;
+    // the whole file when it's mapped, otherwise `buffer`.
+    utf8_t* map;
+    size_t map_len;
+    utf8_t* buffer;
+    // bytes of a character cut off by the end of the last read, moved to the front of the buffer.
+    size_t carry;
+    bool done;
+    // byte offset of the current span in the file.
+    size_t offset;
+} input_t;
+
+static const char* error_names[] = {
+    "none", "unexpected continuation byte", "bad head byte", "truncated character", "overlong encoding", "codepoint too large",
+};
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static bool input_open(input_t* input, const char* name, encoding_t encoding)
+{
+    memset(input, 0, sizeof(*input));
+    input->name = name;
+    input->encoding = encoding;
+    input->fd = strcmp(name, "-") == 0 ? STDIN_FILENO : open(name, O_RDONLY);
+    if (input->fd < 0) {
+        fprintf(stderr, "utf8tool: %s: %s\n", name, strerror(errno));
+        return false;
+    }
+
+    // a private writable mapping, so sanitizing in place only copies the pages it changes.
+    struct stat st;
+    if (fstat(input->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, input->fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            input->map = map;
+            input->map_len = (size_t)st.st_size;
+            return true;
+        }
+    }
+
+    input->buffer = malloc(CHUNK_SIZE);
+    if (!input->buffer) {
+        fprintf(stderr, "utf8tool: out of memory\n");
+        return false;
+    }
+    return true;
+}
+
+static void input_close(input_t* input)
+{
+    if (input->map) munmap(input->map, input->map_len);
+    free(input->buffer);
+    if (input->fd > STDIN_FILENO) close(input->fd);
+}
+
+// where the last whole character in the first `filled` bytes of the buffer ends,
+// so no character is split between two spans.
+static size_t input_boundary(const input_t* input, size_t filled)
+{
+    if (input->encoding == UTF32) {
+        return filled - filled % sizeof(utf32_t);
+    }
+    if (input->encoding == UTF16LE || input->encoding == UTF16BE) {
+        // a high surrogate may pair with the first unit of the next read.
+        size_t end = filled - filled % sizeof(utf16_t);
+        utf8_t high_byte = end >= 2 ? input->buffer[end - (input->encoding == UTF16LE ? 1 : 2)] : 0;
+        return (high_byte & 0xFC) == 0xD8 ? end - 2 : end;
+    }
+    // a utf8 character starts at the last head in the last 3 bytes.
+    for (size_t back = 1; back <= 3 && back <= filled; back++) {
+        if (!utf8_is_continuation(input->buffer[filled - back])) {
+            return filled - back;
+        }
+    }
+    return filled;
+}
+
+// gets the next span of the file, returning false at the end or on a read error.
+static bool input_next(input_t* input, utf8_t** span, size_t* len, bool* failed)
+{
+    *failed = false;
+    if (input->done) return false;
+
+    if (input->map) {
+        input->done = true;
+        *span = input->map;
+        *len = input->map_len;
+        return true;
+    }
+
+    size_t filled = input->carry;
+    while (filled < CHUNK_SIZE) {
+        ssize_t n = read(input->fd, input->buffer + filled, CHUNK_SIZE - filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            fprintf(stderr, "utf8tool: %s: %s\n", input->name, strerror(errno));
+            *failed = true;
+            return false;
+        }
+        if (n == 0) {
+            input->done = true;
+            break;
+        }
+        filled += (size_t)n;
+    }
+
+    // hold back a character that may continue in the next read.
+    size_t end = input->done ? filled : input_boundary(input, filled);
+
+    *span = input->buffer;
+    *len = end;
+    input->carry = filled - end;
+    return filled > 0;
+}
+
+// moves the held back bytes to the front of the buffer, once the span has been used.
+static void input_advance(input_t* input, size_t len)
+{
+    input->offset += len;
+    if (input->buffer && input->carry) {
+        memmove(input->buffer, input->buffer + len, input->carry);
+    }
+}
+
+static bool write_all(const void* data, size_t len)
+{
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            fprintf(stderr, "utf8tool: write: %s\n", strerror(errno));
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// runs the chunks of the `_parallel` functions on a thread each.
+struct call {
+    void (*task)(void* job, size_t chunk);
+    void* job;
+    size_t chunk;
+};
+
+static void* run_one(void* arg)
+{
+    struct call* c = arg;
+    c->task(c->job, c->chunk);
+    return NULL;
+}
+
+static void run_threads(void* pool, void (*task)(void* job, size_t chunk), void* job, size_t nchunks)
+{
+    (void)pool;
+    pthread_t threads[UTF8_PARALLEL_MAX_CHUNKS];
+    struct call calls[UTF8_PARALLEL_MAX_CHUNKS];
+    size_t started = 0;
+    for (size_t i = 0; i < nchunks; i++) {
+        calls[i] = (struct call){ task, job, i };
+        if (pthread_create(&threads[i], NULL, run_one, &calls[i]) != 0) {
+            // run what couldn't get a thread here instead.
+            run_one(&calls[i]);
+            continue;
+        }
+        threads[started++] = threads[i];
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// transcodes a utf8 span in pieces that fit the output buffer, returning the number of bytes read.
+static size_t transcode_from_utf8(const options_t* options, const utf8_t* span, size_t len, void* out, bool* ok)
+{
+    // `utf8_decode_string` is always lossy, so in strict mode utf32 is only decoded up to the first error.
+    size_t end = len;
+    utf8_validation_t validation;
+    if (options->to == UTF32 && options->strict && !utf8_validate_ex(span, len, &validation)) {
+        end = validation.offset;
+    }
+
+    size_t i = 0;
+    while (i < end) {
+        transcoded_t result;
+        size_t unit;
+        if (options->to == UTF32) {
+            result = utf8_decode_string(span + i, end - i, out, CHUNK_SIZE);
+            unit = sizeof(utf32_t);
+        } else if (options->to == UTF16LE) {
+            result = utf8_to_utf16le(span + i, len - i, out, CHUNK_SIZE, !options->strict);
+            unit = sizeof(utf16_t);
+        } else {
+            result = utf8_to_utf16be(span + i, len - i, out, CHUNK_SIZE, !options->strict);
+            unit = sizeof(utf16_t);
+        }
+        if (!write_all(out, result.written * unit)) {
+            *ok = false;
+            return i;
+        }
+        i += result.read;
+        // the utf16 transcoders only stop short with space left in strict mode, at an invalid character.
+        if (i < end && options->strict && !utf8_is_valid64(span + i, len - i)) {
+            return i;
+        }
+    }
+    return i;
+}
+
+// transcodes a utf16 or utf32 span to utf8 in pieces that fit the output buffer, returning the number of bytes read.
+static size_t transcode_to_utf8(const options_t* options, const utf8_t* span, size_t len, utf8_t* out, bool* ok)
+{
+    const utf8_t replacement[] = { 0xEF, 0xBF, 0xBD };
+    size_t cap = CHUNK_SIZE * sizeof(utf32_t);
+    size_t unit = options->from == UTF32 ? sizeof(utf32_t) : sizeof(utf16_t);
+    size_t n = len / unit;
+
+    size_t i = 0;
+    while (i < n) {
+        transcoded_t result;
+        if (options->from == UTF32) {
+            result = utf8_encode_string((const utf32_t*)span + i, n - i, out, cap);
+        } else if (options->from == UTF16LE) {
+            result = utf16le_to_utf8((const utf16_t*)span + i, n - i, out, cap, !options->strict);
+        } else {
+            result = utf16be_to_utf8((const utf16_t*)span + i, n - i, out, cap, !options->strict);
+        }
+        if (!write_all(out, result.written)) {
+            *ok = false;
+            return i * unit;
+        }
+        i += result.read;
+
+        // with space left for any character the transcoders only stop short at an invalid one,
+        // an unpaired surrogate in strict mode or a codepoint over U+10FFFF, which `utf8_encode_string` never replaces.
+        if (i < n && cap - result.written >= 4) {
+            if (options->strict) {
+                return i * unit;
+            }
+            if (!write_all(replacement, sizeof(replacement))) {
+                *ok = false;
+                return i * unit;
+            }
+            i++;
+        }
+    }
+
+    // the file ends part way through a code unit.
+    if (len % unit != 0) {
+        if (options->strict) {
+            return n * unit;
+        }
+        if (!write_all(replacement, sizeof(replacement))) {
+            *ok = false;
+            return n * unit;
+        }
+    }
+    return len;
+}
+
+// transcodes a span in pieces that fit the output buffer, returning the number of bytes read.
+static size_t transcode_span(const options_t* options, const utf8_t* span, size_t len, void* out, bool* ok)
+{
+    if (options->from == UTF8) {
+        return transcode_from_utf8(options, span, len, out, ok);
+    }
+    return transcode_to_utf8(options, span, len, out, ok);
+}
+
+// runs the command over one file, returning 0, 1 if it's invalid, or 2 on an io error.
+static int run_file(const options_t* options, const char* name, void* out)
+{
+    input_t input;
+    if (!input_open(&input, name, options->command == TRANSCODE ? options->from : UTF8)) return 2;
+
+    utf8_parallel_t parallel = { run_threads, NULL, options->threads };
+    size_t count = 0, replaced = 0, total = 0;
+    int status = 0;
+    bool failed = false;
+    utf8_t* span;
+    size_t len;
+    double start = now();
+
+    while (status == 0 && input_next(&input, &span, &len, &failed)) {
+        total += len;
+        switch (options->command) {
+        case VALIDATE:
+            // check quickly first, then find where the error is.
+            if (!utf8_is_valid_string_parallel(span, len, &parallel)) {
+                utf8_validation_t result;
+                utf8_validate_ex(span, len, &result);
+                printf("%s: invalid at byte %zu, %s\n", name, input.offset + result.offset, error_names[result.error]);
+                status = 1;
+            }
+            break;
+        case COUNT:
+            count += utf8_count_parallel(span, len, &parallel);
+            break;
+        case SANITIZE:
+            replaced += utf8_replace_malformed_tokens(span, len, options->replacement);
+            if (!write_all(span, len)) status = 2;
+            break;
+        case TRANSCODE: {
+            bool ok = true;
+            size_t read = transcode_span(options, span, len, out, &ok);
+            if (!ok) {
+                status = 2;
+            } else if (read < len) {
+                fprintf(stderr, "utf8tool: %s: invalid at byte %zu\n", name, input.offset + read);
+                status = 1;
+            }
+            break;
+        }
+        }
+        input_advance(&input, len);
+    }
+    if (failed) status = 2;
+
+    // a character cut off by the end of a pipe.
+    if (status == 0 && input.carry) {
+        fprintf(stderr, "utf8tool: %s: internal error, %zu bytes left over\n", name, input.carry);
+        status = 2;
+    }
+
+    double seconds = now() - start;
+    if (status == 0 && options->command == VALIDATE) printf("%s: valid\n", name);
+    if (status == 0 && options->command == COUNT) printf("%s: %zu characters\n", name, count);
+    if (!options->quiet) {
+        fprintf(stderr, "%s: %zu bytes in %.6f s, %.3f GB/s%s", name, total, seconds,
+                seconds > 0 ? total / seconds * 1e-9 : 0.0, input.map ? " (mapped)" : "");
+        if (options->command == SANITIZE) fprintf(stderr, ", %zu bytes replaced", replaced);
+        fprintf(stderr, "\n");
+    }
+
+    input_close(&input);
+    return status;
+}
+
+static int usage(void)
+{
+    fprintf(stderr,
+        "usage: utf8tool validate [-j N] [-q] [FILE...]\n"
+        "       utf8tool count [-j N] [-q] [FILE...]\n"
+        "       utf8tool sanitize [-r CHAR] [-q] [FILE]\n"
+        "       utf8tool transcode [-f utf8|utf16le|utf16be|utf32] -t utf8|utf16le|utf16be|utf32 [--strict] [-q] [FILE]\n"
+        "       one of -f and -t has to be utf8\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) return usage();
+
+    options_t options = { VALIDATE, UTF8, UTF16LE, false, false, '?', 1 };
+    bool has_encoding = false;
+    if (strcmp(argv[1], "validate") == 0) options.command = VALIDATE;
+    else if (strcmp(argv[1], "count") == 0) options.command = COUNT;
+    else if (strcmp(argv[1], "sanitize") == 0) options.command = SANITIZE;
+    else if (strcmp(argv[1], "transcode") == 0) options.command = TRANSCODE;
+    else return usage();
+
+    const char* files[256];
+    int nfiles = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options.threads = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            options.quiet = true;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc && strlen(argv[i + 1]) == 1) {
+            options.replacement = (utf8_t)argv[++i][0];
+        } else if (strcmp(argv[i], "--strict") == 0) {
+            options.strict = true;
+        } else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-f") == 0) && i + 1 < argc) {
+            encoding_t* option = argv[i][1] == 't' ? &options.to : &options.from;
+            const char* encoding = argv[++i];
+            has_encoding |= option == &options.to;
+            if (strcmp(encoding, "utf8") == 0) *option = UTF8;
+            else if (strcmp(encoding, "utf16le") == 0) *option = UTF16LE;
+            else if (strcmp(encoding, "utf16be") == 0) *option = UTF16BE;
+            else if (strcmp(encoding, "utf32") == 0) *option = UTF32;
+            else return usage();
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            return usage();
+        } else if (nfiles < 256) {
+            files[nfiles++] = argv[i];
+        } else {
+            return usage();
+        }
+    }
+    if (nfiles == 0) files[nfiles++] = "-";
+    // output is one stream, so only one file can be converted at a time.
+    if ((options.command == SANITIZE || options.command == TRANSCODE) && nfiles > 1) return usage();
+    // the library only transcodes to and from utf8.
+    if (options.command == TRANSCODE && (!has_encoding || (options.from == UTF8) == (options.to == UTF8))) return usage();
+    if (options.threads < 1) options.threads = 1;
+
+    void* out = NULL;
+    if (options.command == TRANSCODE) {
+        out = malloc(CHUNK_SIZE * sizeof(utf32_t));
+        if (!out) {
+            fprintf(stderr, "utf8tool: out of memory\n");
+            return 2;
+        }
+    }
+
+    int status = 0;
+    for (int i = 0; i < nfiles; i++) {
+        int file_status = run_file(&options, files[i], out);
+        status = file_status > status ? file_status : status;
+    }
+    free(out);
+    return status;
+}
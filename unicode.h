@@ -15,6 +15,9 @@ typedef uint32_t utf32_t;
 // a single byte in a utf8 encoded string
 typedef uint8_t utf8_t;
 
+// a single code unit in a utf16 encoded string
+typedef uint16_t utf16_t;
+
 // casts char* pointer to utf8_t pointer
 #define UTF8_CAST(str) (const utf8_t*)(str)
 
@@ -36,6 +39,12 @@ typedef uint8_t utf8_t;
 // sentinel value for 
 #define UTF8_ILLEGAL (uint32_t)(-1)
 
+// returned from `utf8_find_char` and `utf8_find_substring` when there is no match.
+#define UTF8_NOT_FOUND SIZE_MAX
+
+// sentinel value for `utf8_prev_char` representing when there is no character before the index.
+#define UTF8_START SIZE_MAX
+
 
 // returned from `utf8_decode`, 
 // includes the decoded codepoint `codepoint` and the length `len`. 
@@ -51,10 +60,33 @@ typedef struct decoded_utf8_t {
 #define DECODED_UTF8_LITERAL(CODEPOINT, LENGTH) ((decoded_utf8_t){(CODEPOINT), (LENGTH)})
 #endif
 
+// returned from the whole string transcoding functions, e.g. `utf8_decode_string`.
+// Transcoding stops when the source is exhausted or the next character doesn't fit in the destination,
+// so it can be resumed from `read` and `written` with more space.
+typedef struct transcoded_t {
+  size_t read;    // number of units read from the source, always on a character boundary.
+  size_t written; // number of units written to the destination.
+} transcoded_t;
+
+#ifdef __cplusplus
+#define TRANSCODED_LITERAL(READ, WRITTEN) (transcoded_t{(READ), (WRITTEN)})
+#else
+#define TRANSCODED_LITERAL(READ, WRITTEN) ((transcoded_t){(READ), (WRITTEN)})
+#endif
+
+// Define `UNICODE_STATIC_INLINE` in every file that includes this header to make the per-character functions,
+// e.g. `utf8_decode`, `utf8_length` and `utf8_next_char`, `static inline` so they are inlined into loops in any file.
+// They are then no longer exported from the file with `UNICODE_IMPL`, the whole string functions still are.
+#ifdef UNICODE_STATIC_INLINE
+#define UNICODE_CHAR_API static inline
+#else
+#define UNICODE_CHAR_API
+#endif
+
 /// @brief checks if the byte is a valid continuation byte, i.e. 0b10xxxxxx
 /// @param byte the continuation byte to check.
 /// @return `true` if it is a valid continuation, `false` if not.
-bool utf8_is_continuation(uint8_t byte);
+UNICODE_CHAR_API bool utf8_is_continuation(uint8_t byte);
 
 /// @brief checks if the byte is a valid header byte for a utf8 encoded character, 
 /// i.e. it is 7bit ascii `0b0xxxxxxx`, 
@@ -63,7 +95,7 @@ bool utf8_is_continuation(uint8_t byte);
 /// or a 4 byte utf8 header `0b11110xxx`.
 /// @param head the head byte of the utf8 encoded character
 /// @return `true` if it is a valid continuation, `false` if not.
-bool utf8_is_valid_head(uint8_t head);
+UNICODE_CHAR_API bool utf8_is_valid_head(uint8_t head);
 
 /// @brief checks if a single utf8 encoded character is completely valid, 
 /// checking it has a valid head, isn't truncated, isn't overlong, 
@@ -73,6 +105,12 @@ bool utf8_is_valid_head(uint8_t head);
 /// @return     `true` if the character is a valid utf8 encoding, `false` if not.
 bool utf8_is_valid(const utf8_t* utf8, uint32_t len);
 
+/// @brief `size_t` version of `utf8_is_valid`, for characters near the end of buffers over 4 GiB.
+/// @param utf8 the pointer to the first byte of the utf8 encoded character
+/// @param len  length of the buffer the character is stored in
+/// @return     `true` if the character is a valid utf8 encoding, `false` if not.
+bool utf8_is_valid64(const utf8_t* utf8, size_t len);
+
 /// @brief null terminated version of `utf8_is_valid`. 
 /// checks if a single utf8 encoded character is completely valid, 
 /// checking it has a valid head, isn't truncated, isn't overlong, 
@@ -81,9 +119,83 @@ bool utf8_is_valid(const utf8_t* utf8, uint32_t len);
 /// @return     `true` if the character is a valid utf8 encoding, `false` if not.
 bool utf8_is_valid_nt(const utf8_t* utf8);
 
+/// @brief checks if every character in the string is a valid utf8 encoding.
+/// Uses the widest SIMD kernel enabled at compile time (SSE4.2, AVX2 or AVX-512BW), or supported by the CPU with `UNICODE_DISPATCH`,
+/// define `UNICODE_NO_SIMD` to always use the scalar implementation.
+/// @param utf8 pointer to the first byte of the string
+/// @param len  length of the string in bytes
+/// @return     `true` if the string is valid utf8, `false` if not.
 bool utf8_is_valid_string(const utf8_t* utf8, uint32_t len);
+
+/// @brief `size_t` version of `utf8_is_valid_string`, for strings over 4 GiB.
+/// @param utf8 pointer to the first byte of the string
+/// @param len  length of the string in bytes
+/// @return     `true` if the string is valid utf8, `false` if not.
+bool utf8_is_valid_string64(const utf8_t* utf8, size_t len);
+
+/// @brief null terminated version of `utf8_is_valid_string`.
+/// checks if every character in the string is a valid utf8 encoding.
+/// Finds the terminator and validates in the same pass, a window of the string at a time while it is in the L1 cache.
+/// @note with SIMD enabled the terminator is found with aligned loads of whole blocks, up to 64 bytes,
+/// which can read bytes before `utf8` and after the terminator that are in the same block.
+/// An aligned block never crosses a page boundary so this never faults, and the reads are hidden from AddressSanitizer.
+/// Memory checkers that track every byte, e.g. Valgrind, need partial loads allowed (`--partial-loads-ok=yes`),
+/// or define `UNICODE_NO_SIMD` to read no further than the terminator.
+/// @param utf8 pointer to the first byte of the null terminated string
+/// @return     `true` if the string is valid utf8, `false` if not.
 bool utf8_is_valid_string_nt(const utf8_t* utf8);
 
+// the kind of error `utf8_validate_ex` found, in the order `utf8_is_valid` checks for them.
+typedef enum utf8_error_t {
+  UTF8_ERROR_NONE,                    // the string is valid.
+  UTF8_ERROR_UNEXPECTED_CONTINUATION, // a continuation byte `0b10xxxxxx` where a character should start.
+  UTF8_ERROR_BAD_HEAD,                // a byte that can't start a character, i.e. F9..FF.
+  UTF8_ERROR_TRUNCATED,               // a character cut short by the end of the string or by a byte that isn't a continuation.
+  UTF8_ERROR_OVERLONG,                // a character encoded in more bytes than its codepoint needs.
+  UTF8_ERROR_TOO_LARGE,               // a character with a codepoint greater than U+10FFFF.
+} utf8_error_t;
+
+// returned through `utf8_validate_ex`, where the first error is and what kind of error it is.
+typedef struct utf8_validation_t {
+  size_t offset;      // byte offset of the first invalid character, or the length of the string if it's valid.
+  utf8_error_t error; // the kind of error, `UTF8_ERROR_NONE` if the string is valid.
+} utf8_validation_t;
+
+/// @brief checks if every character in the string is a valid utf8 encoding,
+/// reporting where the first invalid character is and why, without having to scan the string again.
+/// Validates at the same speed as `utf8_is_valid_string`, only the block with the error is checked one character at a time.
+/// @param utf8 pointer to the first byte of the string
+/// @param len  length of the string in bytes
+/// @param result where to write the offset and kind of the first error, must not be null.
+/// @return     `true` if the string is valid utf8, `false` if not.
+bool utf8_validate_ex(const utf8_t* utf8, size_t len, utf8_validation_t* result);
+
+// state of a validator fed a string one chunk at a time, e.g. as it arrives from a socket.
+// A character split between two chunks is held in `pending` until the rest of it arrives.
+typedef struct utf8_stream_validator_t {
+  utf8_t pending[3];   // bytes of a character cut off by the end of the last chunk.
+  uint8_t pending_len; // number of bytes in `pending`.
+  bool valid;          // `false` once an invalid encoding has been fed.
+} utf8_stream_validator_t;
+
+/// @brief resets the validator to the start of a new string.
+/// @param stream the validator state
+void utf8_stream_validator_init(utf8_stream_validator_t* stream);
+
+/// @brief validates the next chunk of a string, continuing from the chunks fed before it.
+/// A character may be split between chunks at any byte, the chunk doesn't need to outlive the call.
+/// @param stream the validator state
+/// @param chunk pointer to the first byte of the chunk
+/// @param len length of the chunk in bytes
+/// @return `false` if an invalid encoding has been found in any chunk so far, `true` if the string could still be valid.
+bool utf8_stream_validator_feed(utf8_stream_validator_t* stream, const utf8_t* chunk, size_t len);
+
+/// @brief ends the string, checking the last chunk didn't end part way through a character.
+/// Resets the validator, so it can be reused for the next string.
+/// @param stream the validator state
+/// @return `true` if the whole string was valid utf8, `false` if not.
+bool utf8_stream_validator_finish(utf8_stream_validator_t* stream);
+
 /// @brief checks utf8 character us not overlong, 
 /// an overlong utf8 character is a multi-byte character with a codepoint that 
 /// could've fit in a smaller multi-byte character. 
@@ -98,7 +210,7 @@ bool utf8_is_overlong_encoding(const utf8_t* utf8);
 /// Assumes the character is otherwise valid, may read past the byte at `utf8` so it 
 /// should only be used after validating that the character is not truncated.
 /// @param codepoint 
-bool utf8_is_valid_codepoint(utf32_t codepoint);
+UNICODE_CHAR_API bool utf8_is_valid_codepoint(utf32_t codepoint);
 
 /// @brief checks if a codepoint is valid, i.e. no greater than U+10FFFF.
 /// @param codepoint 
@@ -107,12 +219,12 @@ bool utf8_is_oversize_codepoint(const utf8_t* utf8);
 /// @brief gets the length of the utf8 encoded character. Returns 1 if it is invalid.
 /// @param utf8 pointer to the first byte in the utf8 encoded character. 
 /// @return the length of the character in bytes
-uint32_t utf8_length(const utf8_t* utf8);
+UNICODE_CHAR_API uint32_t utf8_length(const utf8_t* utf8);
 
 /// @brief gets the length of the utf8 encoding of the codepoint. returns `UNICODE_INVALID_CODEPOINT` if the codepoint is invalid.
 /// @param codepoint 
 /// @return the length of the character in bytes
-uint32_t utf8_codepoint_length(utf32_t codepoint);
+UNICODE_CHAR_API uint32_t utf8_codepoint_length(utf32_t codepoint);
 
 /// @brief counts the number of seperate utf8 characters in a string, including errors.
 /// @param str the utf8 encoded string
@@ -120,12 +232,24 @@ uint32_t utf8_codepoint_length(utf32_t codepoint);
 /// @return the number of sperate utf8 characters, including errors.
 uint32_t utf8_count(const utf8_t* str, size_t len);
 
+/// @brief `size_t` version of `utf8_count`, for strings with more than 2^32 characters.
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @return the number of sperate utf8 characters, including errors.
+size_t utf8_count64(const utf8_t* str, size_t len);
+
 /// @brief null terminated version of `utf8_count`.
 /// counts the number of seperate utf8 characters in a string, including errors.
+/// @note reads past the ends of the string within aligned blocks, like `utf8_is_valid_string_nt`.
 /// @param str the utf8 encoded string
 /// @return the number of sperate utf8 characters, including errors and excluding the null terminator.
 uint32_t utf8_count_nt(const utf8_t* str);
 
+/// @brief `size_t` version of `utf8_count_nt`.
+/// @param str the utf8 encoded string
+/// @return the number of sperate utf8 characters, including errors and excluding the null terminator.
+size_t utf8_count_nt64(const utf8_t* str);
+
 /// @brief decodes a single character from the string. 
 /// If an invalid utf8 encoding is encounter it returns the replacement character U+FFFD "�" and a length of 1.
 /// @param str the utf8 encoded string
@@ -139,7 +263,7 @@ uint32_t utf8_count_nt(const utf8_t* str);
 ///   uint32_t len;
 ///
 /// };
-decoded_utf8_t utf8_decode(const utf8_t* str, size_t len);
+UNICODE_CHAR_API decoded_utf8_t utf8_decode(const utf8_t* str, size_t len);
 
 /// @brief null terminated version of `utf8_decode`.
 /// decodes a single character from the string. 
@@ -156,7 +280,19 @@ decoded_utf8_t utf8_decode(const utf8_t* str, size_t len);
 ///   uint32_t len;
 ///
 /// };
-decoded_utf8_t utf8_decode_nt(const utf8_t* str);
+UNICODE_CHAR_API decoded_utf8_t utf8_decode_nt(const utf8_t* str);
+
+/// @brief decodes a whole string to utf32, writing one codepoint per character into `dst`.
+/// Gives the same codepoints as calling `utf8_decode` in a loop,
+/// each invalid utf8 encoding is decoded as the replacement character U+FFFD "�" and a length of 1.
+/// Runs of ascii, 2 byte and 3 byte characters are decoded 16 bytes at a time with SSE4.2 when it is enabled.
+/// @param src the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param dst the buffer to write codepoints to
+/// @param dst_cap the length of `dst` in codepoints
+/// @return the number of bytes read from `src` and codepoints written to `dst`.
+/// Stops early once `dst` is full, decoding can be resumed from `src + read`.
+transcoded_t utf8_decode_string(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap);
 
 /// @brief encodes a single unicode character in utf8, storing it in buffer and returning the number of bytes written.
 /// If there is insufficient space in the buffer to store the characer, it doesn't write the character and returns 0.
@@ -178,21 +314,124 @@ size_t utf8_encode(utf8_t* buffer, size_t len, utf32_t codepoint);
 /// @return the number of bytes written, or `UNICODE_INVALID_CODEPOINT` if the codepoint is invalid.
 size_t utf8_encode_nt(utf8_t* buffer, size_t len, utf32_t codepoint);
 
+/// @brief encodes a whole utf32 string in utf8, giving the same bytes as calling `utf8_encode` in a loop.
+/// With SSE4.2 codepoints are classified by encoded length 4 at a time, 
+/// placed with a prefix sum of the lengths and packed with a single shuffle.
+/// @param src the codepoints to encode
+/// @param n the number of codepoints in `src`
+/// @param dst the buffer to write to
+/// @param cap the length of `dst` in bytes
+/// @return the number of codepoints read from `src` and bytes written to `dst`.
+/// Stops early if the next character doesn't fit in `dst`, so encoding can be resumed from `src + read`,
+/// or at a codepoint greater than U+10FFFF, i.e. when `!utf8_is_valid_codepoint(src[read])`.
+transcoded_t utf8_encode_string(const utf32_t* src, size_t n, utf8_t* dst, size_t cap);
+
+/// @brief transcodes a utf8 string to little endian utf16, writing characters above U+FFFF as surrogate pairs.
+/// Characters are read with the same rules as `utf8_decode`,
+/// surrogate codepoints it accepts are written as a single code unit.
+/// @param src the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param dst the buffer to write code units to
+/// @param dst_cap the length of `dst` in code units
+/// @param lossy if `true` each invalid utf8 encoding is written as the replacement character U+FFFD "�",
+/// if `false` transcoding stops at the first invalid encoding.
+/// @return the number of bytes read from `src` and code units written to `dst`.
+/// Stops early once the next character doesn't fit in `dst`,
+/// or in strict mode at an invalid encoding, i.e. when `!utf8_is_valid(src + read, len - read)`.
+transcoded_t utf8_to_utf16le(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool lossy);
+
+/// @brief big endian version of `utf8_to_utf16le`.
+/// transcodes a utf8 string to big endian utf16, writing characters above U+FFFF as surrogate pairs.
+/// @param src the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param dst the buffer to write code units to
+/// @param dst_cap the length of `dst` in code units
+/// @param lossy if `true` each invalid utf8 encoding is written as the replacement character U+FFFD "�",
+/// if `false` transcoding stops at the first invalid encoding.
+/// @return the number of bytes read from `src` and code units written to `dst`.
+transcoded_t utf8_to_utf16be(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool lossy);
+
+/// @brief transcodes a little endian utf16 string to utf8.
+/// @param src the utf16 encoded string
+/// @param n the length of the string in code units
+/// @param dst the buffer to write to
+/// @param dst_cap the length of `dst` in bytes
+/// @param lossy if `true` each unpaired surrogate is written as the replacement character U+FFFD "�",
+/// if `false` transcoding stops at the first unpaired surrogate.
+/// @return the number of code units read from `src` and bytes written to `dst`.
+/// Stops early once the next character doesn't fit in `dst`, or in strict mode at an unpaired surrogate.
+transcoded_t utf16le_to_utf8(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool lossy);
+
+/// @brief big endian version of `utf16le_to_utf8`.
+/// transcodes a big endian utf16 string to utf8.
+/// @param src the utf16 encoded string
+/// @param n the length of the string in code units
+/// @param dst the buffer to write to
+/// @param dst_cap the length of `dst` in bytes
+/// @param lossy if `true` each unpaired surrogate is written as the replacement character U+FFFD "�",
+/// if `false` transcoding stops at the first unpaired surrogate.
+/// @return the number of code units read from `src` and bytes written to `dst`.
+transcoded_t utf16be_to_utf8(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool lossy);
+
+/// @brief the exact number of codepoints `utf8_decode_string` writes for the string,
+/// so `dst` can be allocated once and the whole string decoded in one call.
+/// Each invalid encoding is one U+FFFD, so this is the same as `utf8_count64`.
+/// @param src the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @return the length of the string in utf32 codepoints.
+size_t utf8_utf32_length(const utf8_t* src, size_t len);
+
+/// @brief the exact number of code units `utf8_to_utf16le` and `utf8_to_utf16be` write for the string in lossy mode.
+/// In strict mode it's the same for valid utf8, and an upper bound otherwise.
+/// Runs of the string are validated a block at a time when SIMD is enabled,
+/// then the units are counted while they are still in cache: one for every head byte and another for every 4 byte head.
+/// @param src the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @return the length of the string in utf16 code units.
+size_t utf8_utf16_length(const utf8_t* src, size_t len);
+
+/// @brief the exact number of bytes `utf8_encode_string` writes for the codepoints.
+/// Codepoints greater than U+10FFFF are counted as U+FFFD, 3 bytes each,
+/// `utf8_encode_string` stops at them so this is an upper bound when there are any.
+/// @param src the codepoints to encode
+/// @param n the number of codepoints in `src`
+/// @return the length of the codepoints encoded in utf8 in bytes.
+size_t utf32_utf8_length(const utf32_t* src, size_t n);
+
+/// @brief the exact number of bytes `utf16le_to_utf8` writes for the string in lossy mode.
+/// Each unpaired surrogate is counted as U+FFFD, 3 bytes, so in strict mode it's an upper bound.
+/// @param src the little endian utf16 encoded string
+/// @param n the length of the string in code units
+/// @return the length of the string in utf8 in bytes.
+size_t utf16le_utf8_length(const utf16_t* src, size_t n);
+
+/// @brief big endian version of `utf16le_utf8_length`.
+/// the exact number of bytes `utf16be_to_utf8` writes for the string in lossy mode.
+/// @param src the big endian utf16 encoded string
+/// @param n the length of the string in code units
+/// @return the length of the string in utf8 in bytes.
+size_t utf16be_utf8_length(const utf16_t* src, size_t n);
+
 /// @brief goes from continuation byte and iterates backwards until it finds the head byte of character. 
-/// @warning Assumes valid utf8.
+/// @warning Assumes valid utf8, it has no lower bound so use `utf8_prev_char` for untrusted strings.
 /// @param str pointer to arbitrary point in string
 /// @return pointer to first byte of utf8 encoded character
 utf8_t* utf8_goto_head(char* str);
 
 /// @brief checks if byte is 7bit ascii
 /// @param byte 
-bool utf8_is_7bit_ascii(utf8_t byte);
+UNICODE_CHAR_API bool utf8_is_7bit_ascii(utf8_t byte);
 
 /// @brief checks if string is 7bit ascii
 bool utf8_is_7bit_ascii_string(const utf8_t* str, uint32_t len);
 
-/// @brief null terminated version of `utf8_is_7bit_ascii_string_nt`
+/// @brief `size_t` version of `utf8_is_7bit_ascii_string`, for strings over 4 GiB.
+/// checks if string is 7bit ascii
+bool utf8_is_7bit_ascii_string64(const utf8_t* str, size_t len);
+
+/// @brief null terminated version of `utf8_is_7bit_ascii_string`
 /// checks if string is 7bit ascii
+/// @note reads past the ends of the string within aligned blocks, like `utf8_is_valid_string_nt`.
 bool utf8_is_7bit_ascii_string_nt(const utf8_t* str);
 
 /// @brief gets the index of the next char after the char at `idx`.
@@ -202,7 +441,14 @@ bool utf8_is_7bit_ascii_string_nt(const utf8_t* str);
 /// @param len length of the string in bytes
 /// @param idx byte index of the current char
 /// @return byte index of the next char or `UTF8_END` if the string is exhausted
-uint32_t utf8_next_char(utf8_t* str, uint32_t len, uint32_t idx);
+UNICODE_CHAR_API uint32_t utf8_next_char(utf8_t* str, uint32_t len, uint32_t idx);
+
+/// @brief `size_t` version of `utf8_next_char`, for strings over 4 GiB.
+/// @param str pointer to the string
+/// @param len length of the string in bytes
+/// @param idx byte index of the current char
+/// @return byte index of the next char or `UTF8_END` if the string is exhausted
+UNICODE_CHAR_API size_t utf8_next_char64(const utf8_t* str, size_t len, size_t idx);
 
 /// @brief null terminated version of `utf8_next_char`
 /// gets the index of the next char after the char at `idx`.
@@ -211,7 +457,13 @@ uint32_t utf8_next_char(utf8_t* str, uint32_t len, uint32_t idx);
 /// @param str pointer to the null terminated string
 /// @param idx byte index of the current char
 /// @return byte index of the next char or `UTF8_END` if the string is exhausted
-uint32_t utf8_next_char_nt(utf8_t* str, uint32_t idx);
+UNICODE_CHAR_API uint32_t utf8_next_char_nt(utf8_t* str, uint32_t idx);
+
+/// @brief `size_t` version of `utf8_next_char_nt`, for strings over 4 GiB.
+/// @param str pointer to the null terminated string
+/// @param idx byte index of the current char
+/// @return byte index of the next char or `UTF8_END` if the string is exhausted
+UNICODE_CHAR_API size_t utf8_next_char_nt64(const utf8_t* str, size_t idx);
 
 /// @brief gets the index of the next char after the char at `idx`.
 /// returns `UTF8_END` once string exhausted.
@@ -223,7 +475,16 @@ uint32_t utf8_next_char_nt(utf8_t* str, uint32_t idx);
 /// @param len length of the string in bytes
 /// @param idx byte index of the current char
 /// @return byte index of the next char or `UTF8_END` if the string is exhausted
-uint32_t utf8_next_char_unsafe(utf8_t* str, uint32_t len, uint32_t idx);
+UNICODE_CHAR_API uint32_t utf8_next_char_unsafe(utf8_t* str, uint32_t len, uint32_t idx);
+
+/// @brief `size_t` version of `utf8_next_char_unsafe`, for strings over 4 GiB.
+///
+/// @warning does NOT check for invalid encodings, see `utf8_next_char_unsafe`.
+/// @param str pointer to the string
+/// @param len length of the string in bytes
+/// @param idx byte index of the current char
+/// @return byte index of the next char or `UTF8_END` if the string is exhausted
+UNICODE_CHAR_API size_t utf8_next_char_unsafe64(const utf8_t* str, size_t len, size_t idx);
 
 /// @brief null terminated version of `utf8_next_char_unsafe`
 /// gets the index of the next char after the char at `idx`.
@@ -235,22 +496,305 @@ uint32_t utf8_next_char_unsafe(utf8_t* str, uint32_t len, uint32_t idx);
 /// @param str pointer to the null terminated string
 /// @param idx byte index of the current char
 /// @return byte index of the next char or `UTF8_END` if the string is exhausted
-uint32_t utf8_next_char_unsafe_nt(utf8_t* str, uint32_t idx);
+UNICODE_CHAR_API uint32_t utf8_next_char_unsafe_nt(utf8_t* str, uint32_t idx);
 
-/* FUTURE `string.h` functionality to be added
-int utf8_replace_malformed_tokens(utf8_t* str, uint32_t len, utf8_t chr);
-int utf8_replace_malformed_tokens_nt(utf8_t* str, utf8_t chr);
+/// @brief `size_t` version of `utf8_next_char_unsafe_nt`, for strings over 4 GiB.
+///
+/// @warning does NOT check for invalid encodings, see `utf8_next_char_unsafe`.
+/// @param str pointer to the null terminated string
+/// @param idx byte index of the current char
+/// @return byte index of the next char or `UTF8_END` if the string is exhausted
+UNICODE_CHAR_API size_t utf8_next_char_unsafe_nt64(const utf8_t* str, size_t idx);
 
+/// @brief gets the index of the char before the char at `idx`, the reverse of `utf8_next_char`.
+/// Follows the same rules, if the bytes before `idx` aren't a valid utf8 character it steps back by 1 byte.
+/// Looks at most 4 bytes back from `idx`, so it never walks through a run of continuation bytes.
+/// @param str pointer to the string
+/// @param len length of the string in bytes
+/// @param idx byte index of the current char, or `len`, should be an index `utf8_next_char` can return.
+/// @return byte index of the previous char or `UTF8_START` if `idx` is 0.
+size_t utf8_prev_char(const utf8_t* str, size_t len, size_t idx);
+
+/// @brief gets the length to cut the string to so that it fits in `max_bytes` without splitting a character.
+/// Only a valid character that doesn't fit is dropped, each malformed byte is a character of its own like in `utf8_next_char`.
+/// Looks at most 4 bytes back from `max_bytes`, so it takes the same time however long the string is.
+/// @param str pointer to the string
+/// @param len length of the string in bytes
+/// @param max_bytes the most bytes the string can be cut to
+/// @return the new length in bytes, `len` if the string already fits.
+size_t utf8_truncate(const utf8_t* str, size_t len, size_t max_bytes);
+
+/// @brief replaces each byte of every invalid utf8 encoding with `chr`, in place.
+/// Follows the same rule as `utf8_decode`, each invalid encoding is one byte long,
+/// so the string keeps its length and valid characters after an error are kept.
+/// Valid runs are checked a block at a time and never written to.
+/// @param str pointer to the string
+/// @param len length of the string in bytes
+/// @param chr the replacement byte, should be ascii so the result is valid utf8.
+/// @return the number of bytes replaced, 0 if the string was already valid and hasn't changed.
+size_t utf8_replace_malformed_tokens(utf8_t* str, size_t len, utf8_t chr);
 
-int utf8_cmp(const utf8_t* lhs, uint32_t lhs_len, const utf8_t* rhs, uint32_t rhs_len);
+/// @brief null terminated version of `utf8_replace_malformed_tokens`.
+/// replaces each byte of every invalid utf8 encoding with `chr`, in place.
+/// @note reads past the ends of the string within aligned blocks, like `utf8_is_valid_string_nt`.
+/// @param str pointer to the null terminated string
+/// @param chr the replacement byte, should be ascii so the result is valid utf8, and not null.
+/// @return the number of bytes replaced, 0 if the string was already valid and hasn't changed.
+size_t utf8_replace_malformed_tokens_nt(utf8_t* str, utf8_t chr);
+
+/// @brief copying version of `utf8_replace_malformed_tokens`.
+/// copies `src` to `dst`, replacing each byte of every invalid utf8 encoding with `chr`.
+/// Valid runs are checked and copied a block at a time.
+/// @param src pointer to the string
+/// @param len length of the string in bytes
+/// @param dst the buffer to write to, must have space for `len` bytes, may be the same as `src`.
+/// @param chr the replacement byte, should be ascii so the result is valid utf8.
+/// @return the number of bytes replaced, 0 if `dst` is an exact copy of `src`.
+size_t utf8_replace_malformed_tokens_copy(const utf8_t* src, size_t len, utf8_t* dst, utf8_t chr);
+
+/// @brief finds the first occurrence of a character in the string.
+/// The character is encoded once and searched for as bytes, a vector at a time when SIMD is enabled.
+/// A match always starts at a character, since the head byte it starts with can't appear inside another character.
+/// Invalid encodings in `str` never match, even when searching for U+FFFD.
+/// The single byte `F8` matches U+00F8, since `utf8_decode` gives that codepoint for it,
+/// and codepoints `utf8_decode` never gives, U+0800 to U+0FFF and U+20000 to U+2FFFF, are never found.
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param codepoint the character to find
+/// @return byte index of the first match, or `UTF8_NOT_FOUND` if there isn't one or the codepoint is invalid.
+size_t utf8_find_char(const utf8_t* str, size_t len, utf32_t codepoint);
+
+/// @brief null terminated version of `utf8_find_char`.
+/// finds the first occurrence of a character in the string.
+/// @note reads past the ends of the string within aligned blocks, like `utf8_is_valid_string_nt`.
+/// @param str the null terminated utf8 encoded string
+/// @param codepoint the character to find, the null terminator itself is never found.
+/// @return byte index of the first match, or `UTF8_NOT_FOUND` if there isn't one or the codepoint is invalid.
+size_t utf8_find_char_nt(const utf8_t* str, utf32_t codepoint);
+
+/// @brief codepoint index version of `utf8_find_char`.
+/// finds the first occurrence of a character in the string, counting invalid encodings as one character each like `utf8_count`.
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param codepoint the character to find
+/// @return codepoint index of the first match, or `UTF8_NOT_FOUND` if there isn't one or the codepoint is invalid.
+size_t utf8_find_char_index(const utf8_t* str, size_t len, utf32_t codepoint);
+
+/// @brief finds the first occurrence of a substring in the string.
+/// Candidates are found by comparing the first and last bytes of the substring a vector at a time when SIMD is enabled,
+/// then checked byte by byte.
+/// If `substr` is valid utf8 a match always starts at a character.
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param substr the utf8 encoded substring to find
+/// @param sublen the length of the substring in bytes
+/// @return byte index of the first match, or `UTF8_NOT_FOUND` if there isn't one. An empty substring matches at 0.
+size_t utf8_find_substring(const utf8_t* str, size_t len, const utf8_t* substr, size_t sublen);
+
+/// @brief null terminated version of `utf8_find_substring`.
+/// finds the first occurrence of a substring in the string.
+/// @note reads past the ends of the string within aligned blocks, like `utf8_is_valid_string_nt`.
+/// @param str the null terminated utf8 encoded string
+/// @param substr the null terminated utf8 encoded substring to find
+/// @return byte index of the first match, or `UTF8_NOT_FOUND` if there isn't one. An empty substring matches at 0.
+size_t utf8_find_substring_nt(const utf8_t* str, const utf8_t* substr);
+
+/// @brief codepoint index version of `utf8_find_substring`.
+/// finds the first occurrence of a substring in the string, counting invalid encodings as one character each like `utf8_count`.
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param substr the utf8 encoded substring to find
+/// @param sublen the length of the substring in bytes
+/// @return codepoint index of the first match, or `UTF8_NOT_FOUND` if there isn't one. An empty substring matches at 0.
+size_t utf8_find_substring_index(const utf8_t* str, size_t len, const utf8_t* substr, size_t sublen);
+
+/// @brief compares two strings in codepoint order.
+/// Strings are ordered like the sequences of codepoints `utf8_decode` gives for them,
+/// so each malformed byte sorts as U+FFFD, and a string sorts before any longer string starting with the same characters.
+/// The first differing byte is found a block at a time when SIMD is enabled, and only the characters from there are decoded.
+/// For valid utf8 this is the same order as comparing bytes, apart from the single byte `F8` which decodes as U+00F8.
+/// @param lhs the first utf8 encoded string
+/// @param lhs_len the length of `lhs` in bytes
+/// @param rhs the second utf8 encoded string
+/// @param rhs_len the length of `rhs` in bytes
+/// @return negative if `lhs` sorts first, positive if `rhs` sorts first, 0 if they decode to the same codepoints.
+int utf8_cmp(const utf8_t* lhs, size_t lhs_len, const utf8_t* rhs, size_t rhs_len);
+
+/// @brief null terminated version of `utf8_cmp`.
+/// compares two strings in codepoint order.
+/// @param lhs the first null terminated utf8 encoded string
+/// @param rhs the second null terminated utf8 encoded string
+/// @return negative if `lhs` sorts first, positive if `rhs` sorts first, 0 if they decode to the same codepoints.
 int utf8_cmp_nt(const utf8_t* lhs, const utf8_t* rhs);
 
-int utf8_find_char(const utf8_t* str, uint32_t len, const utf8_t* chr);
-int utf8_find_char_nt(const utf8_t* str, const utf8_t* chr);
+/// @brief compares two strings in codepoint order like `utf8_cmp`, also giving the length of their common prefix.
+/// The prefix is made of whole characters with identical bytes in both strings,
+/// so it never ends part way through a character, e.g. for splitting the edges of a radix tree.
+/// @param lhs the first utf8 encoded string
+/// @param lhs_len the length of `lhs` in bytes
+/// @param rhs the second utf8 encoded string
+/// @param rhs_len the length of `rhs` in bytes
+/// @param prefix set to the length of the common prefix in bytes, must not be null.
+/// @return negative if `lhs` sorts first, positive if `rhs` sorts first, 0 if they decode to the same codepoints.
+int utf8_cmp_prefix(const utf8_t* lhs, size_t lhs_len, const utf8_t* rhs, size_t rhs_len, size_t* prefix);
+
+// a sparse index from codepoint positions to byte offsets in a string, built by `utf8_index_build`.
+// holds the byte offset of every `stride`th character, counting invalid encodings as one character each like `utf8_count`.
+typedef struct utf8_index_t {
+    const utf8_t* str;
+    size_t len;
+    // the number of characters in the string.
+    size_t count;
+    size_t stride;
+    // `checkpoints[k]` is the byte offset of character `k * stride`, in a caller allocated buffer.
+    size_t* checkpoints;
+    size_t n;
+} utf8_index_t;
+
+/// @brief gets the number of checkpoints `utf8_index_build` needs for a string, so the buffer can be allocated up front.
+/// @param len the length of the string in bytes
+/// @param stride the number of characters between checkpoints, must not be 0.
+/// @return the number of `size_t` checkpoints needed, enough for any string of `len` bytes.
+size_t utf8_index_capacity(size_t len, size_t stride);
+
+/// @brief builds a sparse index of the string in one pass, counting characters a block at a time when SIMD is enabled.
+/// The string must stay alive and unchanged while the index is used.
+/// @param index the index to build
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param stride the number of characters between checkpoints, smaller is faster to look up but uses more space.
+/// @param checkpoints the buffer to store checkpoints in
+/// @param cap the length of `checkpoints`, at least `utf8_index_capacity(len, stride)`.
+/// @return `false` if `stride` is 0 or `cap` is too small, leaving the index unbuilt.
+bool utf8_index_build(utf8_index_t* index, const utf8_t* str, size_t len, size_t stride, size_t* checkpoints, size_t cap);
+
+/// @brief gets the byte offset of a character from its codepoint position,
+/// by looking up the checkpoint before it and stepping over at most `stride - 1` characters.
+/// @param index the index of the string
+/// @param codepoint the position of the character, counting invalid encodings as one character each.
+/// @return byte index of the character, the length of the string if `codepoint` is the number of characters,
+/// or `UTF8_NOT_FOUND` if it's past the end.
+size_t utf8_index_codepoint_to_byte(const utf8_index_t* index, size_t codepoint);
+
+/// @brief gets the codepoint position of the character containing a byte,
+/// by binary searching the checkpoints and stepping over at most `stride - 1` characters.
+/// @param index the index of the string
+/// @param byte byte index into the string
+/// @return the position of the character containing `byte`, the number of characters if `byte` is the length of the string,
+/// or `UTF8_NOT_FOUND` if it's past the end.
+size_t utf8_index_byte_to_codepoint(const utf8_index_t* index, size_t byte);
+
+// the longest string `utf8_validate_batch` copies, longer strings are already long enough for the block kernels.
+#define UTF8_BATCH_MAX_PACKED 256
+
+// the size of the buffer `utf8_validate_batch` copies strings into, and the most strings copied into it at a time.
+#define UTF8_BATCH_PACKED_SIZE 4096
+#define UTF8_BATCH_PACKED_STRINGS 256
+
+// a string given by a pointer and a length, for `utf8_validate_batch`.
+typedef struct utf8_span_t {
+    const utf8_t* str;
+    size_t len;
+} utf8_span_t;
+
+/// @brief validates and counts many short strings in one call, e.g. the rows of a column.
+/// Strings are copied together into a buffer on the stack and checked like `utf8_validate_offsets`,
+/// so the block kernels run over many strings at a time instead of one short string per call.
+/// Strings longer than `UTF8_BATCH_MAX_PACKED` are checked on their own.
+/// @param strings the strings to check
+/// @param n the number of strings
+/// @param valid bitmap of at least `(n + 7) / 8` bytes, bit `k % 8` of byte `k / 8` is set if string `k` is valid,
+/// the same layout as an Arrow validity bitmap. Bits past `n` in the last byte are cleared.
+/// @param counts if not `NULL`, `counts[k]` is set to the number of characters in string `k`, including errors, like `utf8_count64`.
+/// @return the number of invalid strings.
+size_t utf8_validate_batch(const utf8_span_t* strings, size_t n, uint8_t* valid, size_t* counts);
+
+/// @brief validates and counts many strings stored back to back, like an Arrow utf8 array.
+/// The data buffer is validated a run at a time with the block kernels, and a string in a run without errors is valid
+/// if it starts and ends on a character boundary. Only strings near an error are walked one character at a time.
+/// @param data the buffer the strings are stored in
+/// @param offsets `n + 1` non decreasing offsets into `data`, string `k` is the bytes from `offsets[k]` to `offsets[k + 1]`.
+/// @param n the number of strings
+/// @param valid bitmap of at least `(n + 7) / 8` bytes, set like `utf8_validate_batch`.
+/// @param counts if not `NULL`, `counts[k]` is set to the number of characters in string `k`, including errors, like `utf8_count64`.
+/// @return the number of invalid strings.
+size_t utf8_validate_offsets(const utf8_t* data, const int32_t* offsets, size_t n, uint8_t* valid, size_t* counts);
+
+/// @brief `int64_t` offsets version of `utf8_validate_offsets`, like an Arrow large_utf8 array.
+/// @param data the buffer the strings are stored in
+/// @param offsets `n + 1` non decreasing offsets into `data`, string `k` is the bytes from `offsets[k]` to `offsets[k + 1]`.
+/// @param n the number of strings
+/// @param valid bitmap of at least `(n + 7) / 8` bytes, set like `utf8_validate_batch`.
+/// @param counts if not `NULL`, `counts[k]` is set to the number of characters in string `k`, including errors, like `utf8_count64`.
+/// @return the number of invalid strings.
+size_t utf8_validate_offsets64(const utf8_t* data, const int64_t* offsets, size_t n, uint8_t* valid, size_t* counts);
+
+// the most chunks a string is split into by the `_parallel` functions, their partial results are kept on the stack.
+#define UTF8_PARALLEL_MAX_CHUNKS 256
+
+// the smallest chunk worth handing to another thread, shorter strings are split into fewer chunks.
+#define UTF8_PARALLEL_MIN_CHUNK (1 << 16)
+
+// runs `task(job, chunk)` for every chunk in [0, nchunks), in any order and on any threads,
+// returning once every call has returned. Tasks are independent, they never wait on each other.
+typedef void (*utf8_parallel_run_t)(void* pool, void (*task)(void* job, size_t chunk), void* job, size_t nchunks);
+
+// how the `_parallel` functions split up work, the library never creates threads itself.
+// e.g. with a pthread for each chunk:
+//   static void* run_one(void* arg) { struct call* c = arg; c->task(c->job, c->chunk); return NULL; }
+//   static void run(void* pool, void (*task)(void*, size_t), void* job, size_t nchunks) {
+//       pthread_t threads[UTF8_PARALLEL_MAX_CHUNKS]; struct call calls[UTF8_PARALLEL_MAX_CHUNKS];
+//       for (size_t i = 0; i < nchunks; i++) { calls[i] = (struct call){ task, job, i }; pthread_create(&threads[i], NULL, run_one, &calls[i]); }
+//       for (size_t i = 0; i < nchunks; i++) pthread_join(threads[i], NULL);
+//   }
+typedef struct utf8_parallel_t {
+    // the hook that runs the chunks, if null they're run one after another on the calling thread.
+    utf8_parallel_run_t run;
+    // passed through to `run`, e.g. the caller's thread pool.
+    void* pool;
+    // the number of chunks to split the string into, usually the number of threads, at most `UTF8_PARALLEL_MAX_CHUNKS`.
+    size_t chunks;
+} utf8_parallel_t;
+
+/// @brief parallel version of `utf8_is_valid_string`, for very long strings.
+/// The string is split into chunks that each start on a character, found by looking at most 3 bytes back,
+/// so every character, valid or not, is checked whole by exactly one chunk and the result is the same as the serial version.
+/// @param utf8 pointer to the first byte of the string
+/// @param len  length of the string in bytes
+/// @param parallel how to split up and run the work
+/// @return     `true` if the string is valid utf8, `false` if not.
+bool utf8_is_valid_string_parallel(const utf8_t* utf8, size_t len, const utf8_parallel_t* parallel);
+
+/// @brief parallel version of `utf8_count`, for very long strings.
+/// counts the number of seperate utf8 characters in a string, including errors, splitting it like `utf8_is_valid_string_parallel`.
+/// @param str the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param parallel how to split up and run the work
+/// @return the number of seperate utf8 characters, including errors.
+size_t utf8_count_parallel(const utf8_t* str, size_t len, const utf8_parallel_t* parallel);
 
-int utf8_find_substring(const utf8_t* str, uint32_t len, const utf8_t* substr, uint32_t sublen);
-int utf8_find_substring_nt(const utf8_t* str, const utf8_t* substr);
-*/
+/// @brief parallel version of `utf8_decode_string`, for very long strings.
+/// Each chunk is counted first so it knows where its codepoints go in `dst`, then the chunks are decoded.
+/// @param src the utf8 encoded string
+/// @param len the length of the string in bytes
+/// @param dst the buffer to write codepoints to
+/// @param dst_cap the length of `dst` in codepoints
+/// @param parallel how to split up and run the work
+/// @return the number of bytes read from `src` and codepoints written to `dst`, the same as `utf8_decode_string`.
+transcoded_t utf8_decode_string_parallel(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap, const utf8_parallel_t* parallel);
+
+/// @brief gets the name of the SIMD implementation in use: "avx512", "avx2", "sse4.2" or "scalar".
+/// It's fixed at compile time, unless `UNICODE_DISPATCH` is defined when the implementation is compiled,
+/// then every implementation is built and the widest the CPU supports is picked on the first call.
+/// @return the name of the implementation.
+const char* utf8_active_implementation(void);
+
+/// @brief overrides the implementation picked at runtime with `UNICODE_DISPATCH`, e.g. to compare or benchmark them.
+/// Not safe to call while other threads are using the library.
+/// Without `UNICODE_DISPATCH` only the implementation fixed at compile time can be chosen.
+/// @param name the name of the implementation, as returned by `utf8_active_implementation`, or `NULL` to pick the widest supported again.
+/// @return `false` if there's no implementation with that name or the CPU doesn't support it, leaving the implementation unchanged.
+bool utf8_set_implementation(const char* name);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -258,185 +802,206 @@ int utf8_find_substring_nt(const utf8_t* str, const utf8_t* substr);
 
 #endif  // UNICODE_H
 
-#ifdef UNICODE_IMPL
+// the per-character functions, compiled once with `UNICODE_IMPL`, or into every file with `UNICODE_STATIC_INLINE`.
+#if (defined(UNICODE_IMPL) || defined(UNICODE_STATIC_INLINE)) && !defined(UNICODE_CHAR_IMPL)
+#define UNICODE_CHAR_IMPL
 
-utf8_t* utf8_goto_head(char* str) {
-    while (utf8_is_continuation(*str)) str--;
-    return (utf8_t*)str;
-}
+// marks a rarely taken error path, or the common path, so the common path is laid out straight through.
+#if defined(__GNUC__) || defined(__clang__)
+#define UNICODE_UNLIKELY(condition) __builtin_expect(!!(condition), 0)
+#define UNICODE_LIKELY(condition) __builtin_expect(!!(condition), 1)
+#else
+#define UNICODE_UNLIKELY(condition) (condition)
+#define UNICODE_LIKELY(condition) (condition)
+#endif
 
-bool utf8_is_7bit_ascii(utf8_t byte) {
+UNICODE_CHAR_API bool utf8_is_7bit_ascii(utf8_t byte) {
     return byte < 0x80;
 }
 
-bool utf8_is_7bit_ascii_string(const utf8_t* str, uint32_t len) {
-    
-    for (uint32_t i = 0; i < len; i++) {
-        if (!utf8_is_7bit_ascii(str[i])) {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool utf8_is_7bit_ascii_string_nt(const utf8_t* str) {
-    while (*str) {
-        if (!utf8_is_7bit_ascii(*str)) {
-            return false;
-        }
-        str++;
-    }
-    return true;
-}
-
-bool utf8_is_valid_codepoint(utf32_t codepoint) {
+UNICODE_CHAR_API bool utf8_is_valid_codepoint(utf32_t codepoint) {
     return codepoint <= 0x10FFFF;
 }
 
-bool utf8_is_continuation(uint8_t byte) {
+UNICODE_CHAR_API bool utf8_is_continuation(uint8_t byte) {
     return (byte & 0xC0) == 0x80;
 }
 
-bool utf8_is_valid_head(uint8_t byte) {
+UNICODE_CHAR_API bool utf8_is_valid_head(uint8_t byte) {
     return !(byte > 0xF8) & !utf8_is_continuation(byte);
 }
 
-bool utf8_is_valid(const utf8_t* utf8, uint32_t len) {
-    
-    if (!utf8_is_valid_head(*utf8)) {
-        return false;
-    }
-
-    uint32_t utf8_len = utf8_length(utf8);
+UNICODE_CHAR_API uint32_t utf8_length(const utf8_t* utf8) {
+    uint8_t head = *utf8;
+    if (UNICODE_LIKELY(head < 0x80)) return 1;
+    if ((head & 0xe0) == 0xc0) return 2;
+    if ((head & 0xf0) == 0xe0) return 3;
+    if ((head & 0xf8) == 0xf0) return 4;
+    return 1;
+}
 
-    if (utf8_len > len) {
-        return false;
+UNICODE_CHAR_API uint32_t utf8_codepoint_length(utf32_t codepoint) {
+    if (codepoint < 0x80) {
+        return 1;
     }
-    
-    for (uint32_t i = 1; i < utf8_len; i++) {
-        if (!utf8_is_continuation(utf8[i])) {
-            return false;
-        }
+    if (codepoint < 0x800) {
+        return 2;
     }
-
-    if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
-        return false;
+    if (codepoint < 0x10000) {
+        return 3;
     }
-
-    return true;
-}
-
-bool utf8_is_valid_nt(const utf8_t* utf8) {
-    
-    if (!utf8_is_valid_head(*utf8)) {
-        return false;
+    if (codepoint < 0x110000) {
+        return 4;
     }
+    return UNICODE_INVALID_CODEPOINT;
+}
 
-    uint32_t utf8_len = utf8_length(utf8);
-
-    for (uint32_t i = 1; i < utf8_len; i++) {
-        if (!utf8[i] || !utf8_is_continuation(utf8[i])) {
-            return false;
-        }
+/*
+ * Decoder DFA.
+ *
+ * Bytes are mapped to 11 classes, and each state has a row of 11 transitions.
+ * States are stored premultiplied by the number of classes so the next state is one lookup.
+ * Like the block tables, it encodes exactly the rules of `utf8_is_valid`:
+ * `E0` heads are always overlong, `F0` must be followed by 90..9F or B0..BF,
+ * `F4` by 80..8F, and `F8` is a single byte character.
+ * Accepting and rejecting are final, so stepping past the end of a character changes nothing.
+ */
+
+#define UTF8_DFA_CLASSES 11
+#define UTF8_DFA_START   (0 * UTF8_DFA_CLASSES) // before the head byte
+#define UTF8_DFA_ACCEPT  (1 * UTF8_DFA_CLASSES)
+#define UTF8_DFA_REJECT  (2 * UTF8_DFA_CLASSES)
+#define UTF8_DFA_NEED_1  (3 * UTF8_DFA_CLASSES) // 1 more continuation
+#define UTF8_DFA_NEED_2  (4 * UTF8_DFA_CLASSES) // 2 more continuations
+#define UTF8_DFA_NEED_3  (5 * UTF8_DFA_CLASSES) // 3 more continuations
+#define UTF8_DFA_F0      (6 * UTF8_DFA_CLASSES) // after F0, 90..9F or B0..BF then 2 more continuations
+#define UTF8_DFA_F4      (7 * UTF8_DFA_CLASSES) // after F4, 80..8F then 2 more continuations
+
+// the low nibble is the class of the byte, the high nibble is the length of the character it starts, errors have a length of 1.
+// 0: 00..7F and F8, 1: 80..8F, 2: 90..9F, 3: A0..AF, 4: B0..BF, 5: C0, C1, E0, F5..F7 and F9..FF,
+// 6: C2..DF, 7: E1..EF, 8: F0, 9: F1..F3, 10: F4.
+static const uint8_t utf8_dfa_class[256] = {
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12, 0x12,
+    0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13, 0x13,
+    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+    0x15, 0x15, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26,
+    0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26,
+    0x15, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37, 0x37,
+    0x48, 0x49, 0x49, 0x49, 0x4A, 0x15, 0x15, 0x15, 0x10, 0x15, 0x15, 0x15, 0x15, 0x15, 0x15, 0x15,
+};
+
+#define A UTF8_DFA_ACCEPT
+#define R UTF8_DFA_REJECT
+static const uint8_t utf8_dfa_transition[8 * UTF8_DFA_CLASSES] = {
+    A, R, R, R, R, R, UTF8_DFA_NEED_1, UTF8_DFA_NEED_2, UTF8_DFA_F0, UTF8_DFA_NEED_3, UTF8_DFA_F4,
+    A, A, A, A, A, A, A, A, A, A, A,
+    R, R, R, R, R, R, R, R, R, R, R,
+    R, A, A, A, A, R, R, R, R, R, R,
+    R, UTF8_DFA_NEED_1, UTF8_DFA_NEED_1, UTF8_DFA_NEED_1, UTF8_DFA_NEED_1, R, R, R, R, R, R,
+    R, UTF8_DFA_NEED_2, UTF8_DFA_NEED_2, UTF8_DFA_NEED_2, UTF8_DFA_NEED_2, R, R, R, R, R, R,
+    R, R, UTF8_DFA_NEED_2, R, UTF8_DFA_NEED_2, R, R, R, R, R, R,
+    R, UTF8_DFA_NEED_2, R, R, R, R, R, R, R, R, R,
+};
+#undef A
+#undef R
+
+// payload bits of a head byte of each class.
+static const uint8_t utf8_dfa_head_mask[UTF8_DFA_CLASSES] = { 0xFF, 0, 0, 0, 0, 0, 0x1F, 0x0F, 0x07, 0x07, 0x07 };
+
+/// @brief validates and decodes a character in one pass with the DFA, ascii skips it.
+/// The positions read only depend on the length given by the head byte, not on the DFA,
+/// so decoding the next character can start before this one is validated.
+/// Always takes 3 steps after the head so the length of the character doesn't cause a branch,
+/// positions past the end of the character re-read its last byte, which changes nothing once the DFA has accepted or rejected.
+/// @param nt stop reading at a null byte, which the DFA then rejects like any other error.
+/// @return the decoded character, or the replacement character and a length of 1 if it's invalid or longer than `len`.
+static inline decoded_utf8_t utf8_decode_dfa(const utf8_t* str, size_t len, bool nt) {
+    utf8_t b0 = str[0];
+    if (UNICODE_LIKELY(b0 < 0x80 && len > 0)) {
+        return DECODED_UTF8_LITERAL(b0, 1);
     }
+    uint32_t type = utf8_dfa_class[b0] & 0x0F;
+    uint32_t utf8_len = utf8_dfa_class[b0] >> 4;
 
-    if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
-        return false;
+    if (utf8_len > len) {
+        return DECODED_UTF8_LITERAL(UNICODE_REPLACEMENT_CHAR, 1);
     }
 
-    return true;
-}
-
-bool utf8_is_valid_string(const utf8_t* utf8, uint32_t len) {
-    do {
-        if (!utf8_is_valid_head(*utf8)) {
-            return false;
-        }
-
-        uint32_t utf8_len = utf8_length(utf8);
-
-        if (utf8_len > len) {
-            return false;
-        }
+    uint32_t i1 = (1 < utf8_len);
+    utf8_t b1 = str[i1];
+    uint32_t i2 = i1 + ((2 < utf8_len) & (!nt | (b1 != 0)));
+    utf8_t b2 = str[i2];
+    uint32_t i3 = i2 + ((3 < utf8_len) & (!nt | (b2 != 0)));
+    utf8_t b3 = str[i3];
 
-        for (uint32_t i = 1; i < utf8_len; i++) {
-            if (!utf8_is_continuation(utf8[i])) {
-                return false;
-            }
-        }
+    uint32_t state = utf8_dfa_transition[UTF8_DFA_START + type];
+    state = utf8_dfa_transition[state + (utf8_dfa_class[b1] & 0x0F)];
+    state = utf8_dfa_transition[state + (utf8_dfa_class[b2] & 0x0F)];
+    state = utf8_dfa_transition[state + (utf8_dfa_class[b3] & 0x0F)];
 
-        if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
-            return false;
-        }
+    if (UNICODE_UNLIKELY(state != UTF8_DFA_ACCEPT)) {
+        return DECODED_UTF8_LITERAL(UNICODE_REPLACEMENT_CHAR, 1);
+    }
 
-        utf8 += utf8_len;
-        len  -= utf8_len;
-    } while (len > 0);
-    return true;
+    // accumulate as if it were 4 bytes long, then shift out the bytes past the end of the character.
+    utf32_t codepoint = (utf32_t)(b0 & utf8_dfa_head_mask[type]) << 18 | (utf32_t)(b1 & 0x3F) << 12 | (utf32_t)(b2 & 0x3F) << 6 | (b3 & 0x3F);
+    return DECODED_UTF8_LITERAL(codepoint >> (6 * (4 - utf8_len)), utf8_len);
 }
 
+UNICODE_CHAR_API decoded_utf8_t utf8_decode(const utf8_t* str, size_t len) {
+    return utf8_decode_dfa(str, len, false);
+}
 
-bool utf8_is_valid_string_nt(const utf8_t* utf8) {
-    while (*utf8) {
-        if (!utf8_is_valid_head(*utf8)) {
-            return false;
-        }
-
-        uint32_t utf8_len = utf8_length(utf8);
-
-        for (uint32_t i = 1; i < utf8_len; i++) {
-            if (!utf8[i] || !utf8_is_continuation(utf8[i])) {
-                return false;
-            }
-        }
-
-        if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
-            return false;
-        }
+UNICODE_CHAR_API decoded_utf8_t utf8_decode_nt(const utf8_t* str) {
+    if (!*str) return DECODED_UTF8_LITERAL(0, 1);
 
-        utf8 += utf8_len;
-    }
-    return true;
+    // the null terminator stops the DFA, so it never reads past it.
+    return utf8_decode_dfa(str, 4, true);
 }
 
-uint32_t utf8_length(const utf8_t* utf8) {
-    uint8_t head = *utf8;
-    if ((head & 0x80) == 0x00) return 1;
-    if ((head & 0xe0) == 0xc0) return 2;
-    if ((head & 0xf0) == 0xe0) return 3;
-    if ((head & 0xf8) == 0xf0) return 4;
-    return 1;
+UNICODE_CHAR_API uint32_t utf8_next_char(utf8_t* str, uint32_t len, uint32_t idx) {
+    return (uint32_t)utf8_next_char64(str, len, idx);
 }
 
-
-uint32_t utf8_next_char(utf8_t* str, uint32_t len, uint32_t idx) {
-    if (idx >= len) {
+UNICODE_CHAR_API size_t utf8_next_char64(const utf8_t* str, size_t len, size_t idx) {
+    if (UNICODE_UNLIKELY(idx >= len)) {
         // zero is never a valid return value, since if idx == 0 then the smallest return value is 1. 
         // Therefore we can safely use 0 as a sentinel value for end of string.
         return UTF8_END;
     }
     // if an error is detected, only proceed by 1
-    if (!utf8_is_valid(&str[idx], len - idx)) {
-        return idx + 1;
-    }
-    return idx + utf8_length(&str[idx]);
+    return idx + utf8_decode_dfa(&str[idx], len - idx, false).len;
 }
 
-uint32_t utf8_next_char_nt(utf8_t* str, uint32_t idx) {
-    if (str[idx] == 0) {
+UNICODE_CHAR_API uint32_t utf8_next_char_nt(utf8_t* str, uint32_t idx) {
+    return (uint32_t)utf8_next_char_nt64(str, idx);
+}
+
+UNICODE_CHAR_API size_t utf8_next_char_nt64(const utf8_t* str, size_t idx) {
+    if (UNICODE_UNLIKELY(str[idx] == 0)) {
         // zero is never a valid return value, since if idx == 0 then the smallest return value is 1. 
         // Therefore we can safely use 0 as a sentinel value for end of string.
         return UTF8_END; 
     }
     // if an error is detected, only proceed by 1
-    if (!utf8_is_valid_nt(&str[idx])) {
-        return idx + 1;
-    }
-    return idx + utf8_length(&str[idx]);
+    return idx + utf8_decode_dfa(&str[idx], 4, true).len;
 }
 
-uint32_t utf8_next_char_unsafe(utf8_t* str, uint32_t len, uint32_t idx) {
-    if (idx == len) {
+UNICODE_CHAR_API uint32_t utf8_next_char_unsafe(utf8_t* str, uint32_t len, uint32_t idx) {
+    return (uint32_t)utf8_next_char_unsafe64(str, len, idx);
+}
+
+UNICODE_CHAR_API size_t utf8_next_char_unsafe64(const utf8_t* str, size_t len, size_t idx) {
+    if (UNICODE_UNLIKELY(idx == len)) {
         // zero is never a valid return value, since if idx == 0 then the smallest return value is 1. 
         // Therefore we can safely use 0 as a sentinel value for end of string.
         return UTF8_END;
@@ -444,8 +1009,12 @@ uint32_t utf8_next_char_unsafe(utf8_t* str, uint32_t len, uint32_t idx) {
     return idx + utf8_length(&str[idx]);
 }
 
-uint32_t utf8_next_char_unsafe_nt(utf8_t* str, uint32_t idx) {
-    if (str[idx] == 0) {
+UNICODE_CHAR_API uint32_t utf8_next_char_unsafe_nt(utf8_t* str, uint32_t idx) {
+    return (uint32_t)utf8_next_char_unsafe_nt64(str, idx);
+}
+
+UNICODE_CHAR_API size_t utf8_next_char_unsafe_nt64(const utf8_t* str, size_t idx) {
+    if (UNICODE_UNLIKELY(str[idx] == 0)) {
         // zero is never a valid return value, since if idx == 0 then the smallest return value is 1. 
         // Therefore we can safely use 0 as a sentinel value for end of string.
         return UTF8_END; 
@@ -453,49 +1022,1687 @@ uint32_t utf8_next_char_unsafe_nt(utf8_t* str, uint32_t idx) {
     return idx + utf8_length(&str[idx]);
 }
 
-uint32_t utf8_count(const utf8_t* str, size_t len) {
-    uint32_t i = 0, c = 0;
-    while (i < len) {
-        if (utf8_is_valid(&str[i], len - i)) {
-            i += utf8_length(&str[i]);
-        } else {
-            i += 1;
-        }
-        c ++;
+#endif // UNICODE_CHAR_IMPL
+
+#ifdef UNICODE_IMPL
+
+// SIMD kernels are selected at compile time from the target flags, e.g. `-msse4.2`, `-mavx2`, `-mavx512bw` or `-march=native`.
+// Define `UNICODE_DISPATCH` to build every kernel and pick one at runtime instead, see `utf8_set_implementation`.
+// Define `UNICODE_NO_SIMD` to only build the scalar implementations.
+#if !defined(UNICODE_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#if defined(UNICODE_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+// each kernel is compiled for its own target, so none of them need the target flags.
+#define UNICODE_RUNTIME_DISPATCH
+#define UNICODE_SSE42
+#define UNICODE_AVX2
+#define UNICODE_AVX512
+#else
+#if defined(__SSE4_2__) || defined(__AVX2__)
+#define UNICODE_SSE42
+#endif
+#if defined(__AVX2__)
+#define UNICODE_AVX2
+#endif
+#if defined(__AVX512BW__)
+#define UNICODE_AVX512
+#endif
+#endif
+#endif
+
+#if defined(UNICODE_SSE42) || defined(UNICODE_AVX2) || defined(UNICODE_AVX512)
+#include <immintrin.h>
+#endif
+
+// for the null terminated scans, which read whole aligned blocks around the string, see `utf8_scan_nt_blocks_sse42`.
+#if defined(__SANITIZE_ADDRESS__)
+#define UNICODE_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define UNICODE_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef UNICODE_NO_SANITIZE_ADDRESS
+#define UNICODE_NO_SANITIZE_ADDRESS
+#endif
+
+// with runtime dispatch the kernels for each instruction set are compiled for that target,
+// and only called through `utf8_kernels()` once the CPU is known to support it.
+#ifdef UNICODE_RUNTIME_DISPATCH
+#define UNICODE_PRAGMA(...) _Pragma(#__VA_ARGS__)
+#if defined(__clang__)
+#define UNICODE_TARGET_BEGIN(isa) UNICODE_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define UNICODE_TARGET_END UNICODE_PRAGMA(clang attribute pop)
+#else
+#define UNICODE_TARGET_BEGIN(isa) UNICODE_PRAGMA(GCC push_options) UNICODE_PRAGMA(GCC target(isa))
+#define UNICODE_TARGET_END UNICODE_PRAGMA(GCC pop_options)
+#endif
+#else
+#define UNICODE_TARGET_BEGIN(isa)
+#define UNICODE_TARGET_END
+#endif
+
+// index of the lowest set bit, `bits` must not be 0.
+static inline uint32_t utf8_lowest_bit(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctzll(bits);
+#else
+    uint32_t i = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        i++;
     }
-    return c;
+    return i;
+#endif
 }
 
-uint32_t utf8_count_nt(const utf8_t* str) {
-    uint32_t i = 0, c = 0;
-    while (str[i]) {
-        if (utf8_is_valid_nt(&str[i])) {
-            i += utf8_length(&str[i]);
-        } else {
-            i += 1;
-        }
-        c ++;
+// index of the `n`th lowest set bit counting from 0, `bits` must have more than `n` bits set.
+static inline uint32_t utf8_nth_bit(uint64_t bits, size_t n) {
+    while (n--) {
+        bits &= bits - 1;
     }
-    return c;
+    return utf8_lowest_bit(bits);
 }
 
-uint32_t utf8_codepoint_length(utf32_t codepoint) {
-    if (codepoint < 0x80) {
-        return 1;
-    }
-    if (codepoint < 0x800) {
-        return 2;
+static inline bool utf8_bytes_equal(const utf8_t* a, const utf8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return false;
     }
-    if (codepoint < 0x10000) {
-        return 3;
+    return true;
+}
+
+/*
+ * Block validation.
+ *
+ * Every error the scalar validator can find is visible from at most 4 consecutive bytes,
+ * so a block is checked by classifying each byte together with the byte before it
+ * using three 16 entry tables indexed by nibbles, each entry being a bit set of the error
+ * classes that nibble can take part in. A byte is in error if the three entries share a bit.
+ * The 3rd and 4th bytes of long characters are checked separately, as are characters
+ * left incomplete at the end of a block. The last bytes of each block are carried over
+ * to the next, so a character split across blocks is checked like any other.
+ *
+ * The tables encode exactly the rules of `utf8_is_valid`, including its overlong checks
+ * on `E0` and `F0` heads, and `F8` being accepted as a single byte character.
+ */
+
+#define UTF8_TOO_SHORT      (1 << 0) // C0..EF head not followed by a continuation
+#define UTF8_TOO_LONG       (1 << 1) // continuation after a single byte character
+#define UTF8_OVERLONG_3     (1 << 2) // E0 followed by a continuation
+#define UTF8_TOO_LARGE      (1 << 3) // F4 followed by 90..BF, or F5..FF followed by a continuation
+#define UTF8_TOO_SHORT_4    (1 << 4) // F0..FF head, except F8, not followed by a continuation
+#define UTF8_OVERLONG_2     (1 << 5) // C0 or C1 followed by a continuation
+#define UTF8_TOO_LARGE_1000 (1 << 6) // F5..FF followed by 80..8F
+#define UTF8_OVERLONG_4     (1 << 6) // F0 followed by 80..8F or A0..AF
+#define UTF8_TWO_CONTS      (1 << 7) // continuation after a continuation, checked against the 3rd/4th byte rule
+#define UTF8_CARRY          (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+// indexed by the high nibble of the previous byte.
+static const uint8_t utf8_block_byte_1_high[16] = {
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3,
+    UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+};
+
+// indexed by the low nibble of the previous byte.
+static const uint8_t utf8_block_byte_1_low[16] = {
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_OVERLONG_2,
+    UTF8_CARRY | UTF8_TOO_SHORT_4,
+    UTF8_CARRY | UTF8_TOO_SHORT_4,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, // F8 is a single byte character
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+    UTF8_CARRY | UTF8_TOO_SHORT_4 | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+};
+
+// indexed by the high nibble of the current byte.
+static const uint8_t utf8_block_byte_2_high[16] = {
+    UTF8_TOO_SHORT | UTF8_TOO_SHORT_4, UTF8_TOO_SHORT | UTF8_TOO_SHORT_4,
+    UTF8_TOO_SHORT | UTF8_TOO_SHORT_4, UTF8_TOO_SHORT | UTF8_TOO_SHORT_4,
+    UTF8_TOO_SHORT | UTF8_TOO_SHORT_4, UTF8_TOO_SHORT | UTF8_TOO_SHORT_4,
+    UTF8_TOO_SHORT | UTF8_TOO_SHORT_4, UTF8_TOO_SHORT | UTF8_TOO_SHORT_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE | UTF8_OVERLONG_4,
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+    UTF8_TOO_SHORT | UTF8_TOO_SHORT_4, UTF8_TOO_SHORT | UTF8_TOO_SHORT_4,
+    UTF8_TOO_SHORT | UTF8_TOO_SHORT_4, UTF8_TOO_SHORT | UTF8_TOO_SHORT_4,
+};
+
+// a byte in the last 3 of a block greater than these starts a character that continues into the next block.
+static const uint8_t utf8_block_incomplete_max[64] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF,
+};
+
+/// @brief steps back from `idx` to the last character head in the 3 bytes before it,
+/// the bytes before that must already have been validated.
+/// Restarting the scalar validator from there re-checks any character left incomplete by a block.
+/// @return byte index of the head, or `idx` if the 3 bytes before it are all continuations.
+static size_t utf8_char_boundary(const utf8_t* str, size_t idx) {
+    for (size_t back = 1; back <= 3 && back <= idx; back++) {
+        if (!utf8_is_continuation(str[idx - back])) {
+            return idx - back;
+        }
     }
-    if (codepoint < 0x110000) {
-        return 4;
+    return idx;
+}
+
+// reads a code unit stored in the given byte order, independent of the byte order of the host.
+static inline utf16_t utf16_load(const utf16_t* unit, bool big_endian) {
+    const utf8_t* bytes = (const utf8_t*)unit;
+    return big_endian ? (utf16_t)(bytes[0] << 8 | bytes[1]) : (utf16_t)(bytes[0] | bytes[1] << 8);
+}
+
+// writes a code unit in the given byte order, independent of the byte order of the host.
+static inline void utf16_store(utf16_t* unit, utf16_t value, bool big_endian) {
+    utf8_t* bytes = (utf8_t*)unit;
+    bytes[big_endian ? 1 : 0] = (utf8_t)value;
+    bytes[big_endian ? 0 : 1] = (utf8_t)(value >> 8);
+}
+
+// writes a codepoint as one code unit, or as a surrogate pair above U+FFFF. `dst` must have space for 2 units.
+// Doesn't branch on the length, so a mix of pairs and single units doesn't cause mispredictions.
+static inline size_t utf16_store_codepoint(utf16_t* dst, utf32_t codepoint, bool big_endian) {
+    bool pair = codepoint > 0xFFFF;
+    utf16_t high = (utf16_t)(0xD7C0 + (codepoint >> 10));
+    utf16_t low  = (utf16_t)(0xDC00 | (codepoint & 0x3FF));
+    utf16_store(dst, pair ? high : (utf16_t)codepoint, big_endian);
+    utf16_store(dst + 1, low, big_endian);
+    return 1 + pair;
+}
+
+static bool utf8_is_valid_string_scalar(const utf8_t* utf8, size_t len);
+
+// decodes a character the block validator has already checked.
+static inline utf32_t utf8_decode_unchecked(const utf8_t* str, uint32_t utf8_len);
+
+#ifdef UNICODE_SSE42
+
+UNICODE_TARGET_BEGIN("sse4.2,popcnt")
+
+static inline __m128i utf8_block_check_sse42(__m128i input, __m128i prev_input) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i byte_1_high = _mm_loadu_si128((const __m128i*)utf8_block_byte_1_high);
+    const __m128i byte_1_low  = _mm_loadu_si128((const __m128i*)utf8_block_byte_1_low);
+    const __m128i byte_2_high = _mm_loadu_si128((const __m128i*)utf8_block_byte_2_high);
+
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i special_cases = _mm_and_si128(_mm_and_si128(
+        _mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+        _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+    // the 3rd byte after E0..F7 and the 4th byte after F0..F7 must be continuations.
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i third  = _mm_subs_epu8(_mm_sub_epi8(prev2, _mm_set1_epi8((char)0xE0)), _mm_set1_epi8(0x17));
+    __m128i fourth = _mm_subs_epu8(_mm_sub_epi8(prev3, _mm_set1_epi8((char)0xF0)), _mm_set1_epi8(0x07));
+    __m128i must_be_2_3_continuation = _mm_or_si128(
+        _mm_cmpeq_epi8(third, _mm_setzero_si128()),
+        _mm_cmpeq_epi8(fourth, _mm_setzero_si128()));
+
+    return _mm_xor_si128(_mm_and_si128(must_be_2_3_continuation, _mm_set1_epi8((char)0x80)), special_cases);
+}
+
+static inline __m128i utf8_block_incomplete_sse42(__m128i input) {
+    __m128i incomplete = _mm_subs_epu8(input, _mm_loadu_si128((const __m128i*)(utf8_block_incomplete_max + 48)));
+    return _mm_andnot_si128(_mm_cmpeq_epi8(input, _mm_set1_epi8((char)0xF8)), incomplete);
+}
+
+/// @brief validates whole 16 byte blocks of the string.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_validate_blocks_sse42(const utf8_t* str, size_t len) {
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i error;
+        if (_mm_movemask_epi8(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm_setzero_si128();
+        } else {
+            error = utf8_block_check_sse42(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_sse42(input);
+        }
+        if (!_mm_testz_si128(error, error)) {
+            return i;
+        }
+        prev_input = input;
+    }
+    return i;
+}
+
+/// @brief counts the character heads in whole 16 byte blocks of the string, stopping at the first block containing an error.
+/// @param count incremented by the number of heads in the blocks before the one returned.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_count_blocks_sse42(const utf8_t* str, size_t len, size_t* count) {
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    size_t i = 0, c = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i*)(str + i));
+        uint32_t ascii = _mm_movemask_epi8(input);
+        __m128i error;
+        if (ascii == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm_setzero_si128();
+        } else {
+            error = utf8_block_check_sse42(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_sse42(input);
+        }
+        if (!_mm_testz_si128(error, error)) {
+            break;
+        }
+        // every byte that isn't a continuation (signed, greater than 0xBF) starts a character.
+        c += _mm_popcnt_u32(_mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8((char)0xBF))));
+        prev_input = input;
+    }
+    *count += c;
+    return i;
+}
+
+/// @brief records a checkpoint in `index` for every `stride`th head in whole 16 byte blocks of the string,
+/// stopping at the first block containing an error like `utf8_count_blocks_sse42`.
+/// @param count the number of characters before `str`, incremented by the number of heads in the blocks before the one returned.
+/// Checkpoints are recorded as byte offsets from `str`.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_index_blocks_sse42(const utf8_t* str, size_t len, size_t* count, utf8_index_t* index) {
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    size_t i = 0, c = *count, next = index->n * index->stride;
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i error;
+        if (_mm_movemask_epi8(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm_setzero_si128();
+        } else {
+            error = utf8_block_check_sse42(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_sse42(input);
+        }
+        if (!_mm_testz_si128(error, error)) {
+            break;
+        }
+        uint64_t heads = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8((char)0xBF)));
+        size_t first = c;
+        c += _mm_popcnt_u32((uint32_t)heads);
+        for (; next < c; next += index->stride) {
+            index->checkpoints[index->n++] = i + utf8_nth_bit(heads, next - first);
+        }
+        prev_input = input;
+    }
+    *count = c;
+    return i;
+}
+
+static inline size_t utf8_decode_valid_block_sse42(const utf8_t* str, __m128i input, utf32_t* dst, size_t* written);
+
+/// @brief decodes one 16 byte block, starting at a character boundary.
+/// `dst` must have space for 16 codepoints, `len` is the length of the rest of the string and at least 16.
+/// @return the number of bytes decoded, at least 12, always ending on a character boundary.
+static inline size_t utf8_decode_block_sse42(const utf8_t* str, size_t len, utf32_t* dst, size_t* written) {
+    __m128i input = _mm_loadu_si128((const __m128i*)str);
+
+    if (_mm_movemask_epi8(input) == 0) {
+        _mm_storeu_si128((__m128i*)(dst + 0),  _mm_cvtepu8_epi32(input));
+        _mm_storeu_si128((__m128i*)(dst + 4),  _mm_cvtepu8_epi32(_mm_srli_si128(input, 4)));
+        _mm_storeu_si128((__m128i*)(dst + 8),  _mm_cvtepu8_epi32(_mm_srli_si128(input, 8)));
+        _mm_storeu_si128((__m128i*)(dst + 12), _mm_cvtepu8_epi32(_mm_srli_si128(input, 12)));
+        *written += 16;
+        return 16;
+    }
+
+    __m128i error = utf8_block_check_sse42(input, _mm_setzero_si128());
+    if (!_mm_testz_si128(error, error)) {
+        // decode past the block one character at a time, replacing errors.
+        size_t i = 0, w = 0;
+        while (i < 16) {
+            decoded_utf8_t decoded = utf8_decode(str + i, len - i);
+            dst[w++] = decoded.codepoint;
+            i += decoded.len;
+        }
+        *written += w;
+        return i;
+    }
+
+    return utf8_decode_valid_block_sse42(str, input, dst, written);
+}
+
+/// @brief decodes one 16 byte block that has passed `utf8_block_check_sse42`, starting at a character boundary.
+/// `dst` must have space for 16 codepoints.
+/// @return the number of bytes decoded, at least 12, always ending on a character boundary.
+static inline size_t utf8_decode_valid_block_sse42(const utf8_t* str, __m128i input, utf32_t* dst, size_t* written) {
+    uint32_t heads = _mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8((char)0xBF)));
+
+    // 8 two byte characters, the last head is checked since its continuations would be in the next block.
+    if (heads == 0x5555 && str[14] < 0xE0) {
+        // each 16 bit lane holds a character, the head in the low byte.
+        __m128i codepoints = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(input, _mm_set1_epi16(0x1F)), 6),
+            _mm_and_si128(_mm_srli_epi16(input, 8), _mm_set1_epi16(0x3F)));
+        _mm_storeu_si128((__m128i*)(dst + 0), _mm_cvtepu16_epi32(codepoints));
+        _mm_storeu_si128((__m128i*)(dst + 4), _mm_cvtepu16_epi32(_mm_srli_si128(codepoints, 8)));
+        *written += 8;
+        return 16;
+    }
+
+    // 4 three byte characters followed by another head.
+    if ((heads & 0x1FFF) == 0x1249) {
+        // reverse each character into a 32 bit lane, last continuation in the low byte.
+        __m128i lanes = _mm_shuffle_epi8(input, _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+        __m128i codepoints = _mm_or_si128(_mm_or_si128(
+            _mm_and_si128(lanes, _mm_set1_epi32(0x3F)),
+            _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0x0FC0))),
+            _mm_and_si128(_mm_srli_epi32(lanes, 4), _mm_set1_epi32(0xF000)));
+        _mm_storeu_si128((__m128i*)dst, codepoints);
+        *written += 4;
+        return 12;
+    }
+
+    // mixed lengths, decode the characters that end inside the block.
+    // an invalid head in the last bytes is only found by the next block.
+    size_t i = 0, w = 0;
+    while (i < 16) {
+        uint32_t utf8_len = utf8_length(str + i);
+        if (i + utf8_len > 16 || !utf8_is_valid_head(str[i])) {
+            break;
+        }
+        dst[w++] = utf8_decode_unchecked(str + i, utf8_len);
+        i += utf8_len;
+    }
+    *written += w;
+    return i;
+}
+
+/// @brief encodes 4 valid codepoints, `dst` must have space for 16 bytes.
+/// @return the number of bytes written.
+static inline size_t utf8_encode_block_sse42(__m128i codepoints, utf8_t* dst) {
+    const __m128i low_6 = _mm_set1_epi32(0x3F);
+    const __m128i cont = _mm_set1_epi32(0x80);
+
+    // codepoints are no greater than U+10FFFF so signed compares are fine.
+    __m128i ge_2 = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0x7F));
+    __m128i ge_3 = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0x7FF));
+    __m128i ge_4 = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0xFFFF));
+    __m128i lengths = _mm_sub_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_set1_epi32(1), ge_2), ge_3), ge_4);
+
+    // the encoding for every length, head in the low byte.
+    __m128i cont_0 = _mm_or_si128(_mm_and_si128(codepoints, low_6), cont);
+    __m128i cont_1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(codepoints, 6), low_6), cont);
+    __m128i cont_2 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(codepoints, 12), low_6), cont);
+    __m128i utf8_2 = _mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(codepoints, 6), _mm_set1_epi32(0xC0)),
+        _mm_slli_epi32(cont_0, 8));
+    __m128i utf8_3 = _mm_or_si128(_mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(codepoints, 12), _mm_set1_epi32(0xE0)),
+        _mm_slli_epi32(cont_1, 8)),
+        _mm_slli_epi32(cont_0, 16));
+    __m128i utf8_4 = _mm_or_si128(_mm_or_si128(_mm_or_si128(
+        _mm_or_si128(_mm_srli_epi32(codepoints, 18), _mm_set1_epi32(0xF0)),
+        _mm_slli_epi32(cont_2, 8)),
+        _mm_slli_epi32(cont_1, 16)),
+        _mm_slli_epi32(cont_0, 24));
+    __m128i utf8 = _mm_blendv_epi8(codepoints, utf8_2, ge_2);
+    utf8 = _mm_blendv_epi8(utf8, utf8_3, ge_3);
+    utf8 = _mm_blendv_epi8(utf8, utf8_4, ge_4);
+
+    // inclusive prefix sum of the lengths, the end of each character.
+    __m128i ends = _mm_add_epi32(lengths, _mm_slli_si128(lengths, 4));
+    ends = _mm_add_epi32(ends, _mm_slli_si128(ends, 8));
+
+    // output byte k comes from character j, the number of characters ending at or before k,
+    // at byte k - start of j within its lane.
+    __m128i k = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i starts = _mm_shuffle_epi8(ends, _mm_setr_epi8(-1, 0, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    __m128i j = _mm_add_epi8(_mm_set1_epi8(3), _mm_add_epi8(_mm_add_epi8(
+        _mm_cmpgt_epi8(_mm_shuffle_epi8(ends, _mm_set1_epi8(0)), k),
+        _mm_cmpgt_epi8(_mm_shuffle_epi8(ends, _mm_set1_epi8(4)), k)),
+        _mm_cmpgt_epi8(_mm_shuffle_epi8(ends, _mm_set1_epi8(8)), k)));
+    __m128i index = _mm_sub_epi8(_mm_add_epi8(_mm_slli_epi16(j, 2), k), _mm_shuffle_epi8(starts, j));
+
+    _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(utf8, index));
+    return (size_t)_mm_extract_epi32(ends, 3);
+}
+
+/// @brief encodes 8 codepoints that are all 3 byte characters, `dst` must have space for 32 bytes.
+/// @return the number of bytes written.
+static inline size_t utf8_encode_block_3_sse42(__m128i a, __m128i b, utf8_t* dst) {
+    const __m128i low_6 = _mm_set1_epi32(0x3F);
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m128i utf8_a = _mm_or_si128(_mm_or_si128(_mm_or_si128(
+        _mm_srli_epi32(a, 12),
+        _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(a, 6), low_6), 8)),
+        _mm_slli_epi32(_mm_and_si128(a, low_6), 16)),
+        _mm_set1_epi32(0x8080E0));
+    __m128i utf8_b = _mm_or_si128(_mm_or_si128(_mm_or_si128(
+        _mm_srli_epi32(b, 12),
+        _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(b, 6), low_6), 8)),
+        _mm_slli_epi32(_mm_and_si128(b, low_6), 16)),
+        _mm_set1_epi32(0x8080E0));
+    _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(utf8_a, pack));
+    _mm_storeu_si128((__m128i*)(dst + 12), _mm_shuffle_epi8(utf8_b, pack));
+    return 24;
+}
+
+/// @brief encodes 16 codepoints that are all 2 byte characters, packed into 16 bit lanes. `dst` must have space for 32 bytes.
+/// @return the number of bytes written.
+static inline size_t utf8_encode_block_2_sse42(__m128i a, __m128i b, utf8_t* dst) {
+    const __m128i low_6 = _mm_set1_epi16(0x3F);
+    __m128i utf8_a = _mm_or_si128(_mm_or_si128(
+        _mm_srli_epi16(a, 6), _mm_slli_epi16(_mm_and_si128(a, low_6), 8)), _mm_set1_epi16((short)0x80C0));
+    __m128i utf8_b = _mm_or_si128(_mm_or_si128(
+        _mm_srli_epi16(b, 6), _mm_slli_epi16(_mm_and_si128(b, low_6), 8)), _mm_set1_epi16((short)0x80C0));
+    _mm_storeu_si128((__m128i*)dst, utf8_a);
+    _mm_storeu_si128((__m128i*)(dst + 16), utf8_b);
+    return 32;
+}
+
+/// @brief compares whole 16 byte blocks of two strings.
+/// @return byte index of the first difference, or of the first byte after the last whole block.
+static inline size_t utf8_mismatch_blocks_sse42(const utf8_t* lhs, const utf8_t* rhs, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(lhs + i)), _mm_loadu_si128((const __m128i*)(rhs + i)));
+        uint32_t ne = ~(uint32_t)_mm_movemask_epi8(eq) & 0xFFFF;
+        if (ne) {
+            return i + utf8_lowest_bit(ne);
+        }
+    }
+    return i;
+}
+
+/// @brief searches 16 starting positions at a time for `needle`, comparing its first and last bytes with every position at once
+/// and checking the rest only where both match.
+/// @param checked set to the number of starting positions searched, when there is no match.
+/// @return byte index of the first match, or `UTF8_NOT_FOUND`.
+static inline size_t utf8_find_blocks_sse42(const utf8_t* str, size_t len, const utf8_t* needle, size_t n, size_t* checked) {
+    const __m128i first = _mm_set1_epi8((char)needle[0]);
+    const __m128i last = _mm_set1_epi8((char)needle[n - 1]);
+    size_t i = 0;
+    for (; i + n - 1 + 16 <= len; i += 16) {
+        __m128i first_eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(str + i)), first);
+        __m128i last_eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(str + i + n - 1)), last);
+        uint64_t candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(first_eq, last_eq));
+        while (candidates) {
+            size_t at = i + utf8_lowest_bit(candidates);
+            if (utf8_bytes_equal(str + at + 1, needle + 1, n - 1)) {
+                return at;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    *checked = i;
+    return UTF8_NOT_FOUND;
+}
+
+/// @brief finds the null terminator 16 bytes at a time with aligned loads.
+/// An aligned load never crosses a page boundary, so reading the rest of the block before `str` and after the terminator can't fault,
+/// the bytes before `str` are masked off.
+/// @return byte index of the terminator, or an index of at least `max` with no terminator before it.
+UNICODE_NO_SANITIZE_ADDRESS
+static inline size_t utf8_scan_nt_blocks_sse42(const utf8_t* str, size_t max) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t misalign = (uintptr_t)str & 15;
+    uint32_t nulls = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)(str - misalign)), zero)) >> misalign;
+    if (nulls) {
+        return utf8_lowest_bit(nulls);
+    }
+    size_t i = 16 - misalign;
+    for (; i < max; i += 16) {
+        nulls = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)(str + i)), zero));
+        if (nulls) {
+            return i + utf8_lowest_bit(nulls);
+        }
+    }
+    return i;
+}
+
+UNICODE_TARGET_END
+
+#endif // UNICODE_SSE42
+
+#ifdef UNICODE_AVX2
+
+UNICODE_TARGET_BEGIN("avx2,popcnt")
+
+static inline __m256i utf8_block_check_avx2(__m256i input, __m256i prev_input) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)utf8_block_byte_1_high));
+    const __m256i byte_1_low  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)utf8_block_byte_1_low));
+    const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)utf8_block_byte_2_high));
+
+    // alignr works within 128 bit lanes, so line each lane up with the lane before it first.
+    __m256i prev_lanes = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, prev_lanes, 15);
+    __m256i special_cases = _mm256_and_si256(_mm256_and_si256(
+        _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+        _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+    __m256i prev2 = _mm256_alignr_epi8(input, prev_lanes, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, prev_lanes, 13);
+    __m256i third  = _mm256_subs_epu8(_mm256_sub_epi8(prev2, _mm256_set1_epi8((char)0xE0)), _mm256_set1_epi8(0x17));
+    __m256i fourth = _mm256_subs_epu8(_mm256_sub_epi8(prev3, _mm256_set1_epi8((char)0xF0)), _mm256_set1_epi8(0x07));
+    __m256i must_be_2_3_continuation = _mm256_or_si256(
+        _mm256_cmpeq_epi8(third, _mm256_setzero_si256()),
+        _mm256_cmpeq_epi8(fourth, _mm256_setzero_si256()));
+
+    return _mm256_xor_si256(_mm256_and_si256(must_be_2_3_continuation, _mm256_set1_epi8((char)0x80)), special_cases);
+}
+
+static inline __m256i utf8_block_incomplete_avx2(__m256i input) {
+    __m256i incomplete = _mm256_subs_epu8(input, _mm256_loadu_si256((const __m256i*)(utf8_block_incomplete_max + 32)));
+    return _mm256_andnot_si256(_mm256_cmpeq_epi8(input, _mm256_set1_epi8((char)0xF8)), incomplete);
+}
+
+/// @brief validates whole 32 byte blocks of the string.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_validate_blocks_avx2(const utf8_t* str, size_t len) {
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(str + i));
+        __m256i error;
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            error = utf8_block_check_avx2(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_avx2(input);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            return i;
+        }
+        prev_input = input;
+    }
+    return i;
+}
+
+/// @brief counts the character heads in whole 32 byte blocks of the string, stopping at the first block containing an error.
+/// @param count incremented by the number of heads in the blocks before the one returned.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_count_blocks_avx2(const utf8_t* str, size_t len, size_t* count) {
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0, c = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(str + i));
+        __m256i error;
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            error = utf8_block_check_avx2(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_avx2(input);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            break;
+        }
+        c += _mm_popcnt_u32((uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, _mm256_set1_epi8((char)0xBF))));
+        prev_input = input;
+    }
+    *count += c;
+    return i;
+}
+
+/// @brief records a checkpoint in `index` for every `stride`th head in whole 32 byte blocks of the string,
+/// see `utf8_index_blocks_sse42`.
+static inline size_t utf8_index_blocks_avx2(const utf8_t* str, size_t len, size_t* count, utf8_index_t* index) {
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0, c = *count, next = index->n * index->stride;
+    for (; i + 32 <= len; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)(str + i));
+        __m256i error;
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            error = utf8_block_check_avx2(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_avx2(input);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            break;
+        }
+        uint64_t heads = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, _mm256_set1_epi8((char)0xBF)));
+        size_t first = c;
+        c += _mm_popcnt_u32((uint32_t)heads);
+        for (; next < c; next += index->stride) {
+            index->checkpoints[index->n++] = i + utf8_nth_bit(heads, next - first);
+        }
+        prev_input = input;
+    }
+    *count = c;
+    return i;
+}
+
+/// @brief encodes 8 valid codepoints, 4 in each 128 bit lane as in `utf8_encode_block_sse42`. `dst` must have space for 32 bytes.
+/// @return the number of bytes written.
+static inline size_t utf8_encode_block_avx2(__m256i codepoints, utf8_t* dst) {
+    const __m256i low_6 = _mm256_set1_epi32(0x3F);
+    const __m256i cont = _mm256_set1_epi32(0x80);
+
+    __m256i ge_2 = _mm256_cmpgt_epi32(codepoints, _mm256_set1_epi32(0x7F));
+    __m256i ge_3 = _mm256_cmpgt_epi32(codepoints, _mm256_set1_epi32(0x7FF));
+    __m256i ge_4 = _mm256_cmpgt_epi32(codepoints, _mm256_set1_epi32(0xFFFF));
+    __m256i lengths = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_sub_epi32(_mm256_set1_epi32(1), ge_2), ge_3), ge_4);
+
+    __m256i cont_0 = _mm256_or_si256(_mm256_and_si256(codepoints, low_6), cont);
+    __m256i cont_1 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(codepoints, 6), low_6), cont);
+    __m256i cont_2 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(codepoints, 12), low_6), cont);
+    __m256i utf8_2 = _mm256_or_si256(
+        _mm256_or_si256(_mm256_srli_epi32(codepoints, 6), _mm256_set1_epi32(0xC0)),
+        _mm256_slli_epi32(cont_0, 8));
+    __m256i utf8_3 = _mm256_or_si256(_mm256_or_si256(
+        _mm256_or_si256(_mm256_srli_epi32(codepoints, 12), _mm256_set1_epi32(0xE0)),
+        _mm256_slli_epi32(cont_1, 8)),
+        _mm256_slli_epi32(cont_0, 16));
+    __m256i utf8_4 = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(
+        _mm256_or_si256(_mm256_srli_epi32(codepoints, 18), _mm256_set1_epi32(0xF0)),
+        _mm256_slli_epi32(cont_2, 8)),
+        _mm256_slli_epi32(cont_1, 16)),
+        _mm256_slli_epi32(cont_0, 24));
+    __m256i utf8 = _mm256_blendv_epi8(codepoints, utf8_2, ge_2);
+    utf8 = _mm256_blendv_epi8(utf8, utf8_3, ge_3);
+    utf8 = _mm256_blendv_epi8(utf8, utf8_4, ge_4);
+
+    __m256i ends = _mm256_add_epi32(lengths, _mm256_slli_si256(lengths, 4));
+    ends = _mm256_add_epi32(ends, _mm256_slli_si256(ends, 8));
+
+    __m256i k = _mm256_setr_epi8(
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m256i starts = _mm256_shuffle_epi8(ends, _mm256_setr_epi8(
+        -1, 0, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, 0, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    __m256i j = _mm256_add_epi8(_mm256_set1_epi8(3), _mm256_add_epi8(_mm256_add_epi8(
+        _mm256_cmpgt_epi8(_mm256_shuffle_epi8(ends, _mm256_set1_epi8(0)), k),
+        _mm256_cmpgt_epi8(_mm256_shuffle_epi8(ends, _mm256_set1_epi8(4)), k)),
+        _mm256_cmpgt_epi8(_mm256_shuffle_epi8(ends, _mm256_set1_epi8(8)), k)));
+    __m256i index = _mm256_sub_epi8(_mm256_add_epi8(_mm256_slli_epi16(j, 2), k), _mm256_shuffle_epi8(starts, j));
+    __m256i packed = _mm256_shuffle_epi8(utf8, index);
+
+    size_t low_len = (size_t)_mm256_extract_epi32(ends, 3);
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(packed));
+    _mm_storeu_si128((__m128i*)(dst + low_len), _mm256_extracti128_si256(packed, 1));
+    return low_len + (size_t)_mm256_extract_epi32(ends, 7);
+}
+
+/// @brief compares whole 32 byte blocks of two strings, see `utf8_mismatch_blocks_sse42`.
+static inline size_t utf8_mismatch_blocks_avx2(const utf8_t* lhs, const utf8_t* rhs, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(lhs + i)), _mm256_loadu_si256((const __m256i*)(rhs + i)));
+        uint32_t ne = ~(uint32_t)_mm256_movemask_epi8(eq);
+        if (ne) {
+            return i + utf8_lowest_bit(ne);
+        }
+    }
+    return i;
+}
+
+/// @brief searches 32 starting positions at a time for `needle`, see `utf8_find_blocks_sse42`.
+static inline size_t utf8_find_blocks_avx2(const utf8_t* str, size_t len, const utf8_t* needle, size_t n, size_t* checked) {
+    const __m256i first = _mm256_set1_epi8((char)needle[0]);
+    const __m256i last = _mm256_set1_epi8((char)needle[n - 1]);
+    size_t i = 0;
+    for (; i + n - 1 + 32 <= len; i += 32) {
+        __m256i first_eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(str + i)), first);
+        __m256i last_eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(str + i + n - 1)), last);
+        uint64_t candidates = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(first_eq, last_eq));
+        while (candidates) {
+            size_t at = i + utf8_lowest_bit(candidates);
+            if (utf8_bytes_equal(str + at + 1, needle + 1, n - 1)) {
+                return at;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    *checked = i;
+    return UTF8_NOT_FOUND;
+}
+
+/// @brief finds the null terminator 32 bytes at a time with aligned loads, see `utf8_scan_nt_blocks_sse42`.
+UNICODE_NO_SANITIZE_ADDRESS
+static inline size_t utf8_scan_nt_blocks_avx2(const utf8_t* str, size_t max) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t misalign = (uintptr_t)str & 31;
+    uint32_t nulls = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)(str - misalign)), zero)) >> misalign;
+    if (nulls) {
+        return utf8_lowest_bit(nulls);
+    }
+    size_t i = 32 - misalign;
+    for (; i < max; i += 32) {
+        nulls = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)(str + i)), zero));
+        if (nulls) {
+            return i + utf8_lowest_bit(nulls);
+        }
+    }
+    return i;
+}
+
+UNICODE_TARGET_END
+
+#endif // UNICODE_AVX2
+
+#ifdef UNICODE_AVX512
+
+UNICODE_TARGET_BEGIN("avx512f,avx512bw,avx2,popcnt")
+
+// copies a 16 byte table into every 128 bit lane.
+static inline __m512i utf8_broadcast_table_avx512(const uint8_t* table) {
+    return _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i*)table));
+}
+
+static inline __m512i utf8_block_check_avx512(__m512i input, __m512i prev_input) {
+    const __m512i nibble = _mm512_set1_epi8(0x0F);
+    const __m512i byte_1_high = utf8_broadcast_table_avx512(utf8_block_byte_1_high);
+    const __m512i byte_1_low  = utf8_broadcast_table_avx512(utf8_block_byte_1_low);
+    const __m512i byte_2_high = utf8_broadcast_table_avx512(utf8_block_byte_2_high);
+
+    // alignr works within 128 bit lanes, so line each lane up with the lane before it first.
+    __m512i prev_lanes = _mm512_permutex2var_epi64(prev_input, _mm512_set_epi64(13, 12, 11, 10, 9, 8, 7, 6), input);
+    __m512i prev1 = _mm512_alignr_epi8(input, prev_lanes, 15);
+    __m512i special_cases = _mm512_and_si512(_mm512_and_si512(
+        _mm512_shuffle_epi8(byte_1_high, _mm512_and_si512(_mm512_srli_epi16(prev1, 4), nibble)),
+        _mm512_shuffle_epi8(byte_1_low, _mm512_and_si512(prev1, nibble))),
+        _mm512_shuffle_epi8(byte_2_high, _mm512_and_si512(_mm512_srli_epi16(input, 4), nibble)));
+
+    __m512i prev2 = _mm512_alignr_epi8(input, prev_lanes, 14);
+    __m512i prev3 = _mm512_alignr_epi8(input, prev_lanes, 13);
+    __mmask64 third  = _mm512_cmple_epu8_mask(_mm512_sub_epi8(prev2, _mm512_set1_epi8((char)0xE0)), _mm512_set1_epi8(0x17));
+    __mmask64 fourth = _mm512_cmple_epu8_mask(_mm512_sub_epi8(prev3, _mm512_set1_epi8((char)0xF0)), _mm512_set1_epi8(0x07));
+
+    return _mm512_xor_si512(_mm512_maskz_mov_epi8(third | fourth, _mm512_set1_epi8((char)0x80)), special_cases);
+}
+
+static inline __m512i utf8_block_incomplete_avx512(__m512i input) {
+    __m512i incomplete = _mm512_subs_epu8(input, _mm512_loadu_si512((const void*)utf8_block_incomplete_max));
+    return _mm512_maskz_mov_epi8(~_mm512_cmpeq_epi8_mask(input, _mm512_set1_epi8((char)0xF8)), incomplete);
+}
+
+/// @brief validates whole 64 byte blocks of the string.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_validate_blocks_avx512(const utf8_t* str, size_t len) {
+    __m512i prev_input = _mm512_setzero_si512();
+    __m512i prev_incomplete = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i input = _mm512_loadu_si512((const void*)(str + i));
+        __m512i error;
+        if (_mm512_movepi8_mask(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm512_setzero_si512();
+        } else {
+            error = utf8_block_check_avx512(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_avx512(input);
+        }
+        if (_mm512_test_epi8_mask(error, error)) {
+            return i;
+        }
+        prev_input = input;
+    }
+    return i;
+}
+
+/// @brief counts the character heads in whole 64 byte blocks of the string, stopping at the first block containing an error.
+/// @param count incremented by the number of heads in the blocks before the one returned.
+/// @return byte index of the first block containing an error, or of the first byte after the last whole block.
+static inline size_t utf8_count_blocks_avx512(const utf8_t* str, size_t len, size_t* count) {
+    __m512i prev_input = _mm512_setzero_si512();
+    __m512i prev_incomplete = _mm512_setzero_si512();
+    size_t i = 0, c = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i input = _mm512_loadu_si512((const void*)(str + i));
+        __m512i error;
+        if (_mm512_movepi8_mask(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm512_setzero_si512();
+        } else {
+            error = utf8_block_check_avx512(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_avx512(input);
+        }
+        if (_mm512_test_epi8_mask(error, error)) {
+            break;
+        }
+        uint64_t heads = _mm512_cmpgt_epi8_mask(input, _mm512_set1_epi8((char)0xBF));
+        c += _mm_popcnt_u32((uint32_t)heads) + _mm_popcnt_u32((uint32_t)(heads >> 32));
+        prev_input = input;
+    }
+    *count += c;
+    return i;
+}
+
+/// @brief records a checkpoint in `index` for every `stride`th head in whole 64 byte blocks of the string,
+/// see `utf8_index_blocks_sse42`.
+static inline size_t utf8_index_blocks_avx512(const utf8_t* str, size_t len, size_t* count, utf8_index_t* index) {
+    __m512i prev_input = _mm512_setzero_si512();
+    __m512i prev_incomplete = _mm512_setzero_si512();
+    size_t i = 0, c = *count, next = index->n * index->stride;
+    for (; i + 64 <= len; i += 64) {
+        __m512i input = _mm512_loadu_si512((const void*)(str + i));
+        __m512i error;
+        if (_mm512_movepi8_mask(input) == 0) {
+            error = prev_incomplete;
+            prev_incomplete = _mm512_setzero_si512();
+        } else {
+            error = utf8_block_check_avx512(input, prev_input);
+            prev_incomplete = utf8_block_incomplete_avx512(input);
+        }
+        if (_mm512_test_epi8_mask(error, error)) {
+            break;
+        }
+        uint64_t heads = _mm512_cmpgt_epi8_mask(input, _mm512_set1_epi8((char)0xBF));
+        size_t first = c;
+        c += _mm_popcnt_u32((uint32_t)heads) + _mm_popcnt_u32((uint32_t)(heads >> 32));
+        for (; next < c; next += index->stride) {
+            index->checkpoints[index->n++] = i + utf8_nth_bit(heads, next - first);
+        }
+        prev_input = input;
+    }
+    *count = c;
+    return i;
+}
+
+/// @brief compares whole 64 byte blocks of two strings, see `utf8_mismatch_blocks_sse42`.
+static inline size_t utf8_mismatch_blocks_avx512(const utf8_t* lhs, const utf8_t* rhs, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        uint64_t ne = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((const void*)(lhs + i)), _mm512_loadu_si512((const void*)(rhs + i)));
+        if (ne) {
+            return i + utf8_lowest_bit(ne);
+        }
+    }
+    return i;
+}
+
+/// @brief searches 64 starting positions at a time for `needle`, see `utf8_find_blocks_sse42`.
+static inline size_t utf8_find_blocks_avx512(const utf8_t* str, size_t len, const utf8_t* needle, size_t n, size_t* checked) {
+    const __m512i first = _mm512_set1_epi8((char)needle[0]);
+    const __m512i last = _mm512_set1_epi8((char)needle[n - 1]);
+    size_t i = 0;
+    for (; i + n - 1 + 64 <= len; i += 64) {
+        __mmask64 first_eq = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void*)(str + i)), first);
+        uint64_t candidates = _mm512_mask_cmpeq_epi8_mask(first_eq, _mm512_loadu_si512((const void*)(str + i + n - 1)), last);
+        while (candidates) {
+            size_t at = i + utf8_lowest_bit(candidates);
+            if (utf8_bytes_equal(str + at + 1, needle + 1, n - 1)) {
+                return at;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+    *checked = i;
+    return UTF8_NOT_FOUND;
+}
+
+/// @brief finds the null terminator 64 bytes at a time with aligned loads, see `utf8_scan_nt_blocks_sse42`.
+UNICODE_NO_SANITIZE_ADDRESS
+static inline size_t utf8_scan_nt_blocks_avx512(const utf8_t* str, size_t max) {
+    const __m512i zero = _mm512_setzero_si512();
+    size_t misalign = (uintptr_t)str & 63;
+    uint64_t nulls = _mm512_cmpeq_epi8_mask(_mm512_load_si512((const void*)(str - misalign)), zero) >> misalign;
+    if (nulls) {
+        return utf8_lowest_bit(nulls);
+    }
+    size_t i = 64 - misalign;
+    for (; i < max; i += 64) {
+        nulls = _mm512_cmpeq_epi8_mask(_mm512_load_si512((const void*)(str + i)), zero);
+        if (nulls) {
+            return i + utf8_lowest_bit(nulls);
+        }
+    }
+    return i;
+}
+
+UNICODE_TARGET_END
+
+#endif // UNICODE_AVX512
+
+#ifdef UNICODE_SSE42
+
+UNICODE_TARGET_BEGIN("sse4.2,popcnt")
+
+// the transcoding kernels work 16 characters at a time, and are shared by every SIMD implementation.
+
+/// @brief encodes 16 valid codepoints that aren't all ascii, `dst` must have space for 64 bytes.
+/// @return the number of bytes written.
+static inline size_t utf8_encode_16_sse42(__m128i a, __m128i b, __m128i c, __m128i d, utf8_t* dst) {
+    // runs of only 2 byte or only 3 byte characters have a fixed layout.
+    __m128i min = _mm_min_epu32(_mm_min_epu32(a, b), _mm_min_epu32(c, d));
+    __m128i max = _mm_max_epu32(_mm_max_epu32(a, b), _mm_max_epu32(c, d));
+    bool all_2 = _mm_movemask_epi8(_mm_cmplt_epi32(min, _mm_set1_epi32(0x80))) == 0 && _mm_testz_si128(max, _mm_set1_epi32(~0x7FF));
+    bool all_3 = _mm_movemask_epi8(_mm_cmplt_epi32(min, _mm_set1_epi32(0x800))) == 0 && _mm_testz_si128(max, _mm_set1_epi32(~0xFFFF));
+
+    if (all_2) {
+        return utf8_encode_block_2_sse42(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d), dst);
+    }
+    if (all_3) {
+        size_t w = utf8_encode_block_3_sse42(a, b, dst);
+        return w + utf8_encode_block_3_sse42(c, d, dst + w);
+    }
+
+    size_t w = 0;
+#if defined(UNICODE_AVX2) && !defined(UNICODE_RUNTIME_DISPATCH)
+    w += utf8_encode_block_avx2(_mm256_setr_m128i(a, b), dst + w);
+    w += utf8_encode_block_avx2(_mm256_setr_m128i(c, d), dst + w);
+#else
+    w += utf8_encode_block_sse42(a, dst + w);
+    w += utf8_encode_block_sse42(b, dst + w);
+    w += utf8_encode_block_sse42(c, dst + w);
+    w += utf8_encode_block_sse42(d, dst + w);
+#endif
+    return w;
+}
+
+/// @brief decodes 16 byte blocks while there's space for 16 codepoints, replacing errors like `utf8_decode`.
+/// @return the number of bytes read, always ending on a character boundary.
+static inline size_t utf8_decode_blocks_sse42(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap, size_t* written) {
+    size_t i = 0, w = 0;
+    while (i + 16 <= len && w + 16 <= dst_cap) {
+        i += utf8_decode_block_sse42(src + i, len - i, dst + w, &w);
+    }
+    *written = w;
+    return i;
+}
+
+/// @brief encodes blocks of 16 codepoints while there's space for 64 bytes, stopping at a block with an invalid codepoint.
+/// @return the number of codepoints read.
+static inline size_t utf8_encode_blocks_sse42(const utf32_t* src, size_t n, utf8_t* dst, size_t cap, size_t* written) {
+    size_t i = 0, w = 0;
+    const __m128i max_codepoint = _mm_set1_epi32(0x10FFFF);
+    while (i + 16 <= n && w + 64 <= cap) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 12));
+        __m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+
+        if (_mm_testz_si128(all, _mm_set1_epi32(~0x7F))) {
+            _mm_storeu_si128((__m128i*)(dst + w), _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d)));
+            i += 16;
+            w += 16;
+            continue;
+        }
+
+        // leave invalid codepoints to the scalar loop.
+        __m128i valid = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_min_epu32(a, max_codepoint), a), _mm_cmpeq_epi32(_mm_min_epu32(b, max_codepoint), b)),
+            _mm_and_si128(_mm_cmpeq_epi32(_mm_min_epu32(c, max_codepoint), c), _mm_cmpeq_epi32(_mm_min_epu32(d, max_codepoint), d)));
+        if (_mm_movemask_epi8(valid) != 0xFFFF) {
+            break;
+        }
+
+        w += utf8_encode_16_sse42(a, b, c, d, dst + w);
+        i += 16;
+    }
+    *written = w;
+    return i;
+}
+
+static inline __m128i utf16_swap_sse42(__m128i units, bool big_endian) {
+    return big_endian ? _mm_shuffle_epi8(units, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)) : units;
+}
+
+/// @brief transcodes 16 byte blocks to utf16 while there's space for 16 units, stopping at a block with errors.
+/// @return the number of bytes read, always ending on a character boundary.
+static inline size_t utf8_to_utf16_blocks_sse42(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool big_endian, size_t* written) {
+    size_t i = 0, w = 0;
+    while (i + 16 <= len && w + 16 <= dst_cap) {
+        __m128i input = _mm_loadu_si128((const __m128i*)(src + i));
+
+        if (_mm_movemask_epi8(input) == 0) {
+            __m128i zero = _mm_setzero_si128();
+            _mm_storeu_si128((__m128i*)(dst + w),     utf16_swap_sse42(_mm_unpacklo_epi8(input, zero), big_endian));
+            _mm_storeu_si128((__m128i*)(dst + w + 8), utf16_swap_sse42(_mm_unpackhi_epi8(input, zero), big_endian));
+            i += 16;
+            w += 16;
+            continue;
+        }
+
+        __m128i error = utf8_block_check_sse42(input, _mm_setzero_si128());
+        if (!_mm_testz_si128(error, error)) {
+            break;
+        }
+
+        utf32_t codepoints[16] = { 0 };
+        size_t n = 0;
+        i += utf8_decode_valid_block_sse42(src + i, input, codepoints, &n);
+
+        // without any 4 byte heads there are no surrogate pairs, narrow to 16 bits.
+        // Units past `n` are overwritten by the next block.
+        if (_mm_testz_si128(_mm_subs_epu8(input, _mm_set1_epi8((char)0xEF)), _mm_set1_epi8(-1))) {
+            __m128i a = _mm_loadu_si128((const __m128i*)codepoints);
+            __m128i b = _mm_loadu_si128((const __m128i*)(codepoints + 4));
+            __m128i c = _mm_loadu_si128((const __m128i*)(codepoints + 8));
+            __m128i d = _mm_loadu_si128((const __m128i*)(codepoints + 12));
+            _mm_storeu_si128((__m128i*)(dst + w),     utf16_swap_sse42(_mm_packus_epi32(a, b), big_endian));
+            _mm_storeu_si128((__m128i*)(dst + w + 8), utf16_swap_sse42(_mm_packus_epi32(c, d), big_endian));
+            w += n;
+        } else {
+            // the units of the block can fill `dst` exactly, so the last character doesn't write a spare unit.
+            for (size_t k = 0; k + 1 < n; k++) {
+                w += utf16_store_codepoint(dst + w, codepoints[k], big_endian);
+            }
+            if (n > 0 && codepoints[n - 1] > 0xFFFF) {
+                w += utf16_store_codepoint(dst + w, codepoints[n - 1], big_endian);
+            } else if (n > 0) {
+                utf16_store(dst + w++, (utf16_t)codepoints[n - 1], big_endian);
+            }
+        }
+    }
+    *written = w;
+    return i;
+}
+
+/// @brief transcodes blocks of 16 utf16 units while there's space for 64 bytes, stopping at a block with surrogates.
+/// @return the number of units read.
+static inline size_t utf16_to_utf8_blocks_sse42(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool big_endian, size_t* written) {
+    size_t i = 0, w = 0;
+    while (i + 16 <= n && w + 64 <= dst_cap) {
+        __m128i low  = utf16_swap_sse42(_mm_loadu_si128((const __m128i*)(src + i)), big_endian);
+        __m128i high = utf16_swap_sse42(_mm_loadu_si128((const __m128i*)(src + i + 8)), big_endian);
+
+        if (_mm_testz_si128(_mm_or_si128(low, high), _mm_set1_epi16(~0x7F))) {
+            _mm_storeu_si128((__m128i*)(dst + w), _mm_packus_epi16(low, high));
+            i += 16;
+            w += 16;
+            continue;
+        }
+
+        // leave blocks with surrogates to the scalar loop.
+        const __m128i surrogate_mask = _mm_set1_epi16((short)0xF800);
+        const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+        __m128i surrogates = _mm_or_si128(
+            _mm_cmpeq_epi16(_mm_and_si128(low, surrogate_mask), surrogate),
+            _mm_cmpeq_epi16(_mm_and_si128(high, surrogate_mask), surrogate));
+        if (!_mm_testz_si128(surrogates, surrogates)) {
+            break;
+        }
+
+        w += utf8_encode_16_sse42(
+            _mm_cvtepu16_epi32(low),  _mm_cvtepu16_epi32(_mm_srli_si128(low, 8)),
+            _mm_cvtepu16_epi32(high), _mm_cvtepu16_epi32(_mm_srli_si128(high, 8)),
+            dst + w);
+        i += 16;
+    }
+    *written = w;
+    return i;
+}
+
+UNICODE_TARGET_END
+
+#endif // UNICODE_SSE42
+
+// without SIMD no blocks are handled and everything goes through the scalar code.
+static inline size_t utf8_validate_blocks_scalar(const utf8_t* str, size_t len) { (void)str; (void)len; return 0; }
+static inline size_t utf8_count_blocks_scalar(const utf8_t* str, size_t len, size_t* count) { (void)str; (void)len; (void)count; return 0; }
+static inline size_t utf8_index_blocks_scalar(const utf8_t* str, size_t len, size_t* count, utf8_index_t* index) { (void)str; (void)len; (void)count; (void)index; return 0; }
+static inline size_t utf8_find_blocks_scalar(const utf8_t* str, size_t len, const utf8_t* needle, size_t n, size_t* checked) { (void)str; (void)len; (void)needle; (void)n; *checked = 0; return UTF8_NOT_FOUND; }
+static inline size_t utf8_mismatch_blocks_scalar(const utf8_t* lhs, const utf8_t* rhs, size_t len) { (void)lhs; (void)rhs; (void)len; return 0; }
+static inline size_t utf8_decode_blocks_scalar(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap, size_t* written) { (void)src; (void)len; (void)dst; (void)dst_cap; *written = 0; return 0; }
+static inline size_t utf8_encode_blocks_scalar(const utf32_t* src, size_t n, utf8_t* dst, size_t cap, size_t* written) { (void)src; (void)n; (void)dst; (void)cap; *written = 0; return 0; }
+static inline size_t utf8_to_utf16_blocks_scalar(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool big_endian, size_t* written) { (void)src; (void)len; (void)dst; (void)dst_cap; (void)big_endian; *written = 0; return 0; }
+static inline size_t utf16_to_utf8_blocks_scalar(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool big_endian, size_t* written) { (void)src; (void)n; (void)dst; (void)dst_cap; (void)big_endian; *written = 0; return 0; }
+// reads one byte at a time, never past the terminator.
+static inline size_t utf8_scan_nt_blocks_scalar(const utf8_t* str, size_t max) {
+    size_t i = 0;
+    while (i < max && str[i]) i++;
+    return i;
+}
+
+#ifdef UNICODE_RUNTIME_DISPATCH
+
+// the kernels of one implementation, called through `utf8_kernels()`.
+typedef struct utf8_kernels_t {
+    const char* name;  // the name `utf8_active_implementation` returns.
+    size_t block_size; // the bytes the validating, counting and searching kernels check at a time.
+    size_t (*validate_blocks)(const utf8_t* str, size_t len);
+    size_t (*count_blocks)(const utf8_t* str, size_t len, size_t* count);
+    size_t (*index_blocks)(const utf8_t* str, size_t len, size_t* count, utf8_index_t* index);
+    size_t (*find_blocks)(const utf8_t* str, size_t len, const utf8_t* needle, size_t n, size_t* checked);
+    size_t (*mismatch_blocks)(const utf8_t* lhs, const utf8_t* rhs, size_t len);
+    size_t (*scan_nt_blocks)(const utf8_t* str, size_t max);
+    size_t (*decode_blocks)(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap, size_t* written);
+    size_t (*encode_blocks)(const utf32_t* src, size_t n, utf8_t* dst, size_t cap, size_t* written);
+    size_t (*to_utf16_blocks)(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool big_endian, size_t* written);
+    size_t (*from_utf16_blocks)(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool big_endian, size_t* written);
+} utf8_kernels_t;
+
+// every implementation, narrowest first, the wider ones reuse the SSE4.2 transcoding kernels.
+static const utf8_kernels_t utf8_kernels_table[] = {
+    { "scalar", 64,
+      utf8_validate_blocks_scalar, utf8_count_blocks_scalar, utf8_index_blocks_scalar, utf8_find_blocks_scalar,
+      utf8_mismatch_blocks_scalar, utf8_scan_nt_blocks_scalar,
+      utf8_decode_blocks_scalar, utf8_encode_blocks_scalar, utf8_to_utf16_blocks_scalar, utf16_to_utf8_blocks_scalar },
+    { "sse4.2", 16,
+      utf8_validate_blocks_sse42, utf8_count_blocks_sse42, utf8_index_blocks_sse42, utf8_find_blocks_sse42,
+      utf8_mismatch_blocks_sse42, utf8_scan_nt_blocks_sse42,
+      utf8_decode_blocks_sse42, utf8_encode_blocks_sse42, utf8_to_utf16_blocks_sse42, utf16_to_utf8_blocks_sse42 },
+    { "avx2", 32,
+      utf8_validate_blocks_avx2, utf8_count_blocks_avx2, utf8_index_blocks_avx2, utf8_find_blocks_avx2,
+      utf8_mismatch_blocks_avx2, utf8_scan_nt_blocks_avx2,
+      utf8_decode_blocks_sse42, utf8_encode_blocks_sse42, utf8_to_utf16_blocks_sse42, utf16_to_utf8_blocks_sse42 },
+    { "avx512", 64,
+      utf8_validate_blocks_avx512, utf8_count_blocks_avx512, utf8_index_blocks_avx512, utf8_find_blocks_avx512,
+      utf8_mismatch_blocks_avx512, utf8_scan_nt_blocks_avx512,
+      utf8_decode_blocks_sse42, utf8_encode_blocks_sse42, utf8_to_utf16_blocks_sse42, utf16_to_utf8_blocks_sse42 },
+};
+
+#define UTF8_KERNELS_COUNT (sizeof(utf8_kernels_table) / sizeof(utf8_kernels_table[0]))
+
+// the implementation in use, null until the first call picks one.
+static const utf8_kernels_t* utf8_active_kernels;
+
+// gets the widest implementation the CPU and OS support, as an index into `utf8_kernels_table`.
+static size_t utf8_supported_kernels(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("popcnt")) {
+        return 3;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return 2;
+    }
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        return 1;
+    }
+    return 0;
+}
+
+static const utf8_kernels_t* utf8_detect_kernels(void) {
+    const utf8_kernels_t* kernels = &utf8_kernels_table[utf8_supported_kernels()];
+    __atomic_store_n(&utf8_active_kernels, kernels, __ATOMIC_RELAXED);
+    return kernels;
+}
+
+// a load and a predictable branch, the detection only runs once.
+static inline const utf8_kernels_t* utf8_kernels(void) {
+    const utf8_kernels_t* kernels = __atomic_load_n(&utf8_active_kernels, __ATOMIC_RELAXED);
+    if (UNICODE_UNLIKELY(!kernels)) {
+        kernels = utf8_detect_kernels();
+    }
+    return kernels;
+}
+
+#define UTF8_BLOCK_SIZE (utf8_kernels()->block_size)
+#define utf8_validate_blocks (utf8_kernels()->validate_blocks)
+#define utf8_count_blocks (utf8_kernels()->count_blocks)
+#define utf8_index_blocks (utf8_kernels()->index_blocks)
+#define utf8_find_blocks (utf8_kernels()->find_blocks)
+#define utf8_mismatch_blocks (utf8_kernels()->mismatch_blocks)
+#define utf8_scan_nt_blocks (utf8_kernels()->scan_nt_blocks)
+#define utf8_decode_blocks (utf8_kernels()->decode_blocks)
+#define utf8_encode_blocks (utf8_kernels()->encode_blocks)
+#define utf8_to_utf16_blocks (utf8_kernels()->to_utf16_blocks)
+#define utf16_to_utf8_blocks (utf8_kernels()->from_utf16_blocks)
+
+// the widest kernels enabled at compile time.
+#elif defined(UNICODE_AVX512)
+#define UTF8_BLOCK_SIZE 64
+#define utf8_validate_blocks utf8_validate_blocks_avx512
+#define utf8_count_blocks utf8_count_blocks_avx512
+#define utf8_index_blocks utf8_index_blocks_avx512
+#define utf8_find_blocks utf8_find_blocks_avx512
+#define utf8_mismatch_blocks utf8_mismatch_blocks_avx512
+#define utf8_scan_nt_blocks utf8_scan_nt_blocks_avx512
+#define utf8_decode_blocks utf8_decode_blocks_sse42
+#define utf8_encode_blocks utf8_encode_blocks_sse42
+#define utf8_to_utf16_blocks utf8_to_utf16_blocks_sse42
+#define utf16_to_utf8_blocks utf16_to_utf8_blocks_sse42
+#define UTF8_IMPLEMENTATION "avx512"
+#elif defined(UNICODE_AVX2)
+#define UTF8_BLOCK_SIZE 32
+#define utf8_validate_blocks utf8_validate_blocks_avx2
+#define utf8_count_blocks utf8_count_blocks_avx2
+#define utf8_index_blocks utf8_index_blocks_avx2
+#define utf8_find_blocks utf8_find_blocks_avx2
+#define utf8_mismatch_blocks utf8_mismatch_blocks_avx2
+#define utf8_scan_nt_blocks utf8_scan_nt_blocks_avx2
+#define utf8_decode_blocks utf8_decode_blocks_sse42
+#define utf8_encode_blocks utf8_encode_blocks_sse42
+#define utf8_to_utf16_blocks utf8_to_utf16_blocks_sse42
+#define utf16_to_utf8_blocks utf16_to_utf8_blocks_sse42
+#define UTF8_IMPLEMENTATION "avx2"
+#elif defined(UNICODE_SSE42)
+#define UTF8_BLOCK_SIZE 16
+#define utf8_validate_blocks utf8_validate_blocks_sse42
+#define utf8_count_blocks utf8_count_blocks_sse42
+#define utf8_index_blocks utf8_index_blocks_sse42
+#define utf8_find_blocks utf8_find_blocks_sse42
+#define utf8_mismatch_blocks utf8_mismatch_blocks_sse42
+#define utf8_scan_nt_blocks utf8_scan_nt_blocks_sse42
+#define utf8_decode_blocks utf8_decode_blocks_sse42
+#define utf8_encode_blocks utf8_encode_blocks_sse42
+#define utf8_to_utf16_blocks utf8_to_utf16_blocks_sse42
+#define utf16_to_utf8_blocks utf16_to_utf8_blocks_sse42
+#define UTF8_IMPLEMENTATION "sse4.2"
+#else
+#define UTF8_BLOCK_SIZE 64
+#define utf8_validate_blocks utf8_validate_blocks_scalar
+#define utf8_count_blocks utf8_count_blocks_scalar
+#define utf8_index_blocks utf8_index_blocks_scalar
+#define utf8_find_blocks utf8_find_blocks_scalar
+#define utf8_mismatch_blocks utf8_mismatch_blocks_scalar
+#define utf8_scan_nt_blocks utf8_scan_nt_blocks_scalar
+#define utf8_decode_blocks utf8_decode_blocks_scalar
+#define utf8_encode_blocks utf8_encode_blocks_scalar
+#define utf8_to_utf16_blocks utf8_to_utf16_blocks_scalar
+#define utf16_to_utf8_blocks utf16_to_utf8_blocks_scalar
+#define UTF8_IMPLEMENTATION "scalar"
+#endif
+
+// compares two implementation names.
+static bool utf8_names_equal(const char* a, const char* b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+#ifdef UNICODE_RUNTIME_DISPATCH
+
+const char* utf8_active_implementation(void) {
+    return utf8_kernels()->name;
+}
+
+bool utf8_set_implementation(const char* name) {
+    size_t supported = utf8_supported_kernels();
+    if (!name) {
+        __atomic_store_n(&utf8_active_kernels, &utf8_kernels_table[supported], __ATOMIC_RELAXED);
+        return true;
+    }
+    for (size_t k = 0; k < UTF8_KERNELS_COUNT; k++) {
+        if (utf8_names_equal(name, utf8_kernels_table[k].name)) {
+            // narrower implementations only use instructions the wider ones already need.
+            if (k > supported) return false;
+            __atomic_store_n(&utf8_active_kernels, &utf8_kernels_table[k], __ATOMIC_RELAXED);
+            return true;
+        }
+    }
+    return false;
+}
+
+#else
+
+const char* utf8_active_implementation(void) {
+    return UTF8_IMPLEMENTATION;
+}
+
+bool utf8_set_implementation(const char* name) {
+    return !name || utf8_names_equal(name, UTF8_IMPLEMENTATION);
+}
+
+#endif
+
+// bytes of a null terminated string handed to the length versions of the functions at a time,
+// few enough that they are still in the L1 cache after the terminator has been looked for.
+#define UTF8_NT_WINDOW 8192
+
+// gets the length of the next window of the null terminated string, of at least `min` bytes unless it's the last,
+// cut before the last character that might continue past it. Sets `last` if the window ends at the terminator.
+// Splitting at a head byte gives the same results as the whole string, since walking the string always stops at every head.
+static inline size_t utf8_nt_window(const utf8_t* str, size_t min, bool* last) {
+    size_t n = utf8_scan_nt_blocks(str, min);
+    // there's no terminator before `n`, so `str[n]` is still part of the string.
+    *last = str[n] == 0;
+    return *last ? n : utf8_char_boundary(str, n);
+}
+
+utf8_t* utf8_goto_head(char* str) {
+    while (utf8_is_continuation(*str)) str--;
+    return (utf8_t*)str;
+}
+
+bool utf8_is_7bit_ascii_string(const utf8_t* str, uint32_t len) {
+    return utf8_is_7bit_ascii_string64(str, len);
+}
+
+bool utf8_is_7bit_ascii_string64(const utf8_t* str, size_t len) {
+    size_t i = 0;
+    // or together a fixed number of bytes before checking, a loop without an early exit that compilers vectorize.
+    for (; i + 64 <= len; i += 64) {
+        utf8_t bits = 0;
+        for (size_t k = 0; k < 64; k++) {
+            bits |= str[i + k];
+        }
+        if (!utf8_is_7bit_ascii(bits)) {
+            return false;
+        }
+    }
+    for (; i < len; i++) {
+        if (!utf8_is_7bit_ascii(str[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool utf8_is_7bit_ascii_string_nt(const utf8_t* str) {
+    for (bool last = false; !last; ) {
+        size_t n = utf8_nt_window(str, UTF8_NT_WINDOW, &last);
+        if (!utf8_is_7bit_ascii_string64(str, n)) {
+            return false;
+        }
+        str += n;
+    }
+    return true;
+}
+
+bool utf8_is_valid(const utf8_t* utf8, uint32_t len) {
+    return utf8_is_valid64(utf8, len);
+}
+
+bool utf8_is_valid64(const utf8_t* utf8, size_t len) {
+    
+    if (!utf8_is_valid_head(*utf8)) {
+        return false;
+    }
+
+    uint32_t utf8_len = utf8_length(utf8);
+
+    if (utf8_len > len) {
+        return false;
+    }
+    
+    for (uint32_t i = 1; i < utf8_len; i++) {
+        if (!utf8_is_continuation(utf8[i])) {
+            return false;
+        }
+    }
+
+    if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool utf8_is_valid_nt(const utf8_t* utf8) {
+    
+    if (!utf8_is_valid_head(*utf8)) {
+        return false;
+    }
+
+    uint32_t utf8_len = utf8_length(utf8);
+
+    for (uint32_t i = 1; i < utf8_len; i++) {
+        if (!utf8[i] || !utf8_is_continuation(utf8[i])) {
+            return false;
+        }
+    }
+
+    if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
+        return false;
+    }
+
+    return true;
+}
+
+// validates with the block kernels, finishing with the scalar validator.
+bool utf8_is_valid_string64(const utf8_t* utf8, size_t len) {
+    size_t checked = utf8_validate_blocks(utf8, len);
+    // finish from the last character the blocks reached,
+    // if the blocks found an error the scalar validator finds it again in the same block.
+    size_t idx = utf8_char_boundary(utf8, checked);
+    return utf8_is_valid_string_scalar(utf8 + idx, len - idx);
+}
+
+bool utf8_is_valid_string(const utf8_t* utf8, uint32_t len) {
+    return utf8_is_valid_string64(utf8, len);
+}
+
+// classifies the character at `utf8` with the same checks as `utf8_is_valid`, in the same order.
+static utf8_error_t utf8_error_kind(const utf8_t* utf8, size_t len) {
+    if (utf8_is_continuation(*utf8)) {
+        return UTF8_ERROR_UNEXPECTED_CONTINUATION;
+    }
+    if (!utf8_is_valid_head(*utf8)) {
+        return UTF8_ERROR_BAD_HEAD;
+    }
+
+    uint32_t utf8_len = utf8_length(utf8);
+
+    if (utf8_len > len) {
+        return UTF8_ERROR_TRUNCATED;
+    }
+
+    for (uint32_t i = 1; i < utf8_len; i++) {
+        if (!utf8_is_continuation(utf8[i])) {
+            return UTF8_ERROR_TRUNCATED;
+        }
+    }
+
+    if (utf8_is_overlong_encoding(utf8)) {
+        return UTF8_ERROR_OVERLONG;
+    }
+    if (utf8_is_oversize_codepoint(utf8)) {
+        return UTF8_ERROR_TOO_LARGE;
+    }
+    return UTF8_ERROR_NONE;
+}
+
+bool utf8_validate_ex(const utf8_t* utf8, size_t len, utf8_validation_t* result) {
+    size_t checked = utf8_validate_blocks(utf8, len);
+    // like `utf8_is_valid_string`, the failing block is walked again one character at a time to find the error.
+    size_t i = utf8_char_boundary(utf8, checked);
+    while (i < len) {
+        utf8_error_t error = utf8_error_kind(utf8 + i, len - i);
+        if (error != UTF8_ERROR_NONE) {
+            result->offset = i;
+            result->error = error;
+            return false;
+        }
+        i += utf8_length(utf8 + i);
+    }
+    result->offset = len;
+    result->error = UTF8_ERROR_NONE;
+    return true;
+}
+
+// reference implementation, validates character by character.
+static bool utf8_is_valid_string_scalar(const utf8_t* utf8, size_t len) {
+    while (len > 0) {
+        if (!utf8_is_valid_head(*utf8)) {
+            return false;
+        }
+
+        uint32_t utf8_len = utf8_length(utf8);
+
+        if (utf8_len > len) {
+            return false;
+        }
+
+        for (uint32_t i = 1; i < utf8_len; i++) {
+            if (!utf8_is_continuation(utf8[i])) {
+                return false;
+            }
+        }
+
+        if (utf8_is_overlong_encoding(utf8) || utf8_is_oversize_codepoint(utf8)) {
+            return false;
+        }
+
+        utf8 += utf8_len;
+        len  -= utf8_len;
+    }
+    return true;
+}
+
+
+bool utf8_is_valid_string_nt(const utf8_t* utf8) {
+    for (bool last = false; !last; ) {
+        size_t n = utf8_nt_window(utf8, UTF8_NT_WINDOW, &last);
+        if (!utf8_is_valid_string64(utf8, n)) {
+            return false;
+        }
+        utf8 += n;
+    }
+    return true;
+}
+
+// checks the first `len` bytes of a character cut off by the end of a chunk can still be completed into a valid character.
+// Only the second byte of a character is restricted beyond being a continuation,
+// so it's enough to try completing it with the smallest and largest continuation bytes.
+static bool utf8_is_valid_prefix(const utf8_t* utf8, size_t len) {
+    utf8_t smallest[4] = { 0x80, 0x80, 0x80, 0x80 };
+    utf8_t largest[4]  = { 0xBF, 0xBF, 0xBF, 0xBF };
+    for (size_t i = 0; i < len; i++) {
+        smallest[i] = largest[i] = utf8[i];
+    }
+    return utf8_is_valid(smallest, 4) || utf8_is_valid(largest, 4);
+}
+
+void utf8_stream_validator_init(utf8_stream_validator_t* stream) {
+    stream->pending_len = 0;
+    stream->valid = true;
+}
+
+bool utf8_stream_validator_feed(utf8_stream_validator_t* stream, const utf8_t* chunk, size_t len) {
+    if (!stream->valid) {
+        return false;
+    }
+
+    size_t i = 0;
+
+    // finish the character left over from the last chunk.
+    if (stream->pending_len > 0) {
+        utf8_t character[4] = { 0 };
+        uint32_t n = stream->pending_len;
+        for (uint32_t k = 0; k < n; k++) {
+            character[k] = stream->pending[k];
+        }
+
+        uint32_t utf8_len = utf8_length(character);
+        while (n < utf8_len && i < len) {
+            character[n++] = chunk[i++];
+        }
+
+        if (n < utf8_len) {
+            // still not complete, the chunk was shorter than the rest of the character.
+            for (uint32_t k = stream->pending_len; k < n; k++) {
+                stream->pending[k] = character[k];
+            }
+            stream->pending_len = (uint8_t)n;
+            return stream->valid = utf8_is_valid_prefix(character, n);
+        }
+
+        stream->pending_len = 0;
+        if (!utf8_is_valid(character, utf8_len)) {
+            return stream->valid = false;
+        }
+    }
+
+    // the rest of the chunk starts on a character boundary,
+    // hold back a character cut off by the end of the chunk.
+    size_t end = len;
+    size_t head = utf8_char_boundary(chunk + i, len - i) + i;
+    if (head < len && utf8_is_valid_head(chunk[head]) && utf8_length(chunk + head) > len - head) {
+        if (!utf8_is_valid_prefix(chunk + head, len - head)) {
+            return stream->valid = false;
+        }
+        end = head;
+    }
+
+    if (!utf8_is_valid_string64(chunk + i, end - i)) {
+        return stream->valid = false;
+    }
+
+    for (size_t k = end; k < len; k++) {
+        stream->pending[stream->pending_len++] = chunk[k];
+    }
+    return true;
+}
+
+bool utf8_stream_validator_finish(utf8_stream_validator_t* stream) {
+    bool valid = stream->valid && stream->pending_len == 0;
+    utf8_stream_validator_init(stream);
+    return valid;
+}
+
+size_t utf8_prev_char(const utf8_t* str, size_t len, size_t idx) {
+    if (idx == 0) {
+        return UTF8_START;
+    }
+    // every head byte starts a character, so only a valid character from a head in the 4 bytes before can end at `idx`.
+    for (size_t back = 1; back <= 4 && back <= idx; back++) {
+        if (!utf8_is_continuation(str[idx - back])) {
+            decoded_utf8_t decoded = utf8_decode_dfa(&str[idx - back], len - (idx - back), false);
+            return decoded.len == back ? idx - back : idx - 1;
+        }
+    }
+    // otherwise the byte before is an error of its own.
+    return idx - 1;
+}
+
+size_t utf8_truncate(const utf8_t* str, size_t len, size_t max_bytes) {
+    if (max_bytes >= len) {
+        return len;
+    }
+    // only the character from the last head can run past `max_bytes`, heads further back are over 3 bytes away.
+    size_t head = utf8_char_boundary(str, max_bytes);
+    if (head < max_bytes && head + utf8_decode_dfa(&str[head], len - head, false).len > max_bytes) {
+        return head;
+    }
+    return max_bytes;
+}
+
+size_t utf8_count64(const utf8_t* str, size_t len) {
+    size_t i = 0, c = 0;
+    while (i < len) {
+        // count heads a block at a time until a block has an error or there are no whole blocks left.
+        size_t stop = i + utf8_count_blocks(str + i, len - i, &c);
+
+        // the scalar loop restarts from the last head the blocks reached, which they have already counted.
+        size_t restart = i + utf8_char_boundary(str + i, stop - i);
+        c -= restart < stop;
+
+        // count through the failing block, or the tail, one character at a time.
+        size_t end = stop + UTF8_BLOCK_SIZE < len ? stop + UTF8_BLOCK_SIZE : len;
+        for (i = restart; i < end; c++) {
+            i += utf8_decode_dfa(&str[i], len - i, false).len;
+        }
     }
-    return UNICODE_INVALID_CODEPOINT;
+    return c;
+}
+
+uint32_t utf8_count(const utf8_t* str, size_t len) {
+    return (uint32_t)utf8_count64(str, len);
+}
+
+uint32_t utf8_count_nt(const utf8_t* str) {
+    return (uint32_t)utf8_count_nt64(str);
+}
+
+size_t utf8_count_nt64(const utf8_t* str) {
+    size_t c = 0;
+    for (bool last = false; !last; ) {
+        size_t n = utf8_nt_window(str, UTF8_NT_WINDOW, &last);
+        c += utf8_count64(str, n);
+        str += n;
+    }
+    return c;
 }
 
 
+
 bool utf8_is_overlong_encoding(const utf8_t* utf8) {
     uint32_t utf8_len = utf8_length(utf8);
     if (utf8_len == 1) return false;
@@ -512,50 +2719,29 @@ bool utf8_is_oversize_codepoint(const utf8_t* utf8) {
     return true;
 }
 
-decoded_utf8_t utf8_decode(const utf8_t* str, size_t len) {
-    uint32_t utf8_len = utf8_length(str);
-
-    if (!utf8_is_valid(str, len)) {
-        return DECODED_UTF8_LITERAL(UNICODE_REPLACEMENT_CHAR, 1);
-    }
-
+static inline utf32_t utf8_decode_unchecked(const utf8_t* str, uint32_t utf8_len) {
     if (utf8_len == 1) {
-        return DECODED_UTF8_LITERAL(str[0], utf8_len);
+        return str[0];
     }
 
-    utf32_t head_bit_mask = (0x7F >> utf8_len);
-
-    utf32_t codepoint = str[0] & head_bit_mask;
+    utf32_t codepoint = str[0] & (0x7F >> utf8_len);
 
     for (uint32_t i = 1; i < utf8_len; i++) {
         codepoint = (codepoint << 6) | (str[i] & 0x3F);
     }
 
-    return DECODED_UTF8_LITERAL(codepoint, utf8_len);
+    return codepoint;
 }
 
-decoded_utf8_t utf8_decode_nt(const utf8_t* str) {
-    if (!*str) return DECODED_UTF8_LITERAL(0, 1);
-
-    uint32_t utf8_len = utf8_length(str);
-
-    if (!utf8_is_valid_nt(str)) {
-        return DECODED_UTF8_LITERAL(UNICODE_REPLACEMENT_CHAR, 1);
-    }
-
-    if (utf8_len == 1) {
-        return DECODED_UTF8_LITERAL(str[0], utf8_len);
-    }
-
-    utf32_t head_bit_mask = (0x7F >> utf8_len);
-
-    utf32_t codepoint = str[0] & head_bit_mask;
-
-    for (uint32_t i = 1; i < utf8_len; i++) {
-        codepoint = (codepoint << 6) | (str[i] & 0x3F);
+transcoded_t utf8_decode_string(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap) {
+    size_t w = 0;
+    size_t i = utf8_decode_blocks(src, len, dst, dst_cap, &w);
+    while (i < len && w < dst_cap) {
+        decoded_utf8_t decoded = utf8_decode(src + i, len - i);
+        dst[w++] = decoded.codepoint;
+        i += decoded.len;
     }
-
-    return DECODED_UTF8_LITERAL(codepoint, utf8_len);
+    return TRANSCODED_LITERAL(i, w);
 }
 
 size_t utf8_encode(utf8_t* buffer, size_t len, utf32_t codepoint) {
@@ -589,6 +2775,564 @@ size_t utf8_encode(utf8_t* buffer, size_t len, utf32_t codepoint) {
     return utf8_len;
 }
 
+
+// copies `len` bytes, a vector at a time when SIMD is enabled.
+static inline void utf8_copy(utf8_t* dst, const utf8_t* src, size_t len) {
+    size_t i = 0;
+#if defined(UNICODE_SSE42) && (defined(__SSE2__) || defined(_M_X64))
+    for (; i + 16 <= len; i += 16) {
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = src[i];
+    }
+}
+
+// bytes validated before they are copied, small enough that they're still in cache when copied.
+#define UTF8_COPY_RUN_SIZE 4096
+
+size_t utf8_replace_malformed_tokens_copy(const utf8_t* src, size_t len, utf8_t* dst, utf8_t chr) {
+    size_t i = 0, replaced = 0;
+    while (i < len) {
+        size_t run_end = len - i < UTF8_COPY_RUN_SIZE ? len : i + UTF8_COPY_RUN_SIZE;
+        size_t stop = i + utf8_validate_blocks(src + i, run_end - i);
+
+        // copy up to the last character the blocks reached, in place there's nothing to do.
+        size_t restart = i + utf8_char_boundary(src + i, stop - i);
+        if (dst != src) {
+            utf8_copy(dst + i, src + i, restart - i);
+        }
+        i = restart;
+
+        // the blocks only stop short of the end of the run at an error.
+        if (stop + UTF8_BLOCK_SIZE > run_end && run_end < len) {
+            continue;
+        }
+
+        // one character at a time through the failing block, or the tail.
+        size_t end = stop + UTF8_BLOCK_SIZE < len ? stop + UTF8_BLOCK_SIZE : len;
+        while (i < end) {
+            decoded_utf8_t decoded = utf8_decode_dfa(src + i, len - i, false);
+            if (decoded.codepoint == UNICODE_REPLACEMENT_CHAR && decoded.len == 1) {
+                dst[i] = chr;
+                replaced++;
+            } else if (dst != src) {
+                utf8_copy(dst + i, src + i, decoded.len);
+            }
+            i += decoded.len;
+        }
+    }
+    return replaced;
+}
+
+size_t utf8_replace_malformed_tokens(utf8_t* str, size_t len, utf8_t chr) {
+    return utf8_replace_malformed_tokens_copy(str, len, str, chr);
+}
+
+size_t utf8_replace_malformed_tokens_nt(utf8_t* str, utf8_t chr) {
+    size_t replaced = 0;
+    for (bool last = false; !last; ) {
+        size_t n = utf8_nt_window(str, UTF8_NT_WINDOW, &last);
+        replaced += utf8_replace_malformed_tokens(str, n, chr);
+        str += n;
+    }
+    return replaced;
+}
+
+// finds the first occurrence of `n` bytes, a block at a time then position by position through the tail.
+static inline size_t utf8_find_bytes(const utf8_t* str, size_t len, const utf8_t* needle, size_t n) {
+    if (n == 0) return 0;
+    if (n > len) return UTF8_NOT_FOUND;
+
+    size_t i = 0;
+    size_t found = utf8_find_blocks(str, len, needle, n, &i);
+    if (found != UTF8_NOT_FOUND) return found;
+
+    for (; i + n <= len; i++) {
+        if (str[i] == needle[0] && utf8_bytes_equal(str + i + 1, needle + 1, n - 1)) {
+            return i;
+        }
+    }
+    return UTF8_NOT_FOUND;
+}
+
+// null terminated version of `utf8_find_bytes`, `needle` is null terminated too.
+// Windows overlap by one byte less than the needle, so a match across the end of one is found in the next.
+static inline size_t utf8_find_bytes_nt(const utf8_t* str, const utf8_t* needle) {
+    size_t n = 0;
+    while (needle[n]) n++;
+    if (n == 0) return 0;
+
+    size_t min = n * 2 > UTF8_NT_WINDOW ? n * 2 : UTF8_NT_WINDOW;
+    for (size_t i = 0; ; ) {
+        bool last;
+        size_t window = utf8_nt_window(str + i, min, &last);
+        size_t found = utf8_find_bytes(str + i, window, needle, n);
+        if (found != UTF8_NOT_FOUND) return i + found;
+        if (last) return UTF8_NOT_FOUND;
+        i += window - (n - 1);
+    }
+}
+
+size_t utf8_find_char(const utf8_t* str, size_t len, utf32_t codepoint) {
+    utf8_t needle[4];
+    size_t n = utf8_encode(needle, sizeof(needle), codepoint);
+    // codepoints whose encoding `utf8_decode` rejects, e.g. U+0800 to U+0FFF, are never decoded so never found.
+    if (n == UNICODE_INVALID_CODEPOINT || !utf8_is_valid64(needle, n)) return UTF8_NOT_FOUND;
+    size_t found = utf8_find_bytes(str, len, needle, n);
+
+    // the single byte `F8` decodes as U+00F8 too, look for it before the encoded match.
+    if (codepoint == 0xF8) {
+        const utf8_t byte = 0xF8;
+        size_t raw = utf8_find_bytes(str, found == UTF8_NOT_FOUND ? len : found, &byte, 1);
+        found = raw == UTF8_NOT_FOUND ? found : raw;
+    }
+    return found;
+}
+
+size_t utf8_find_char_nt(const utf8_t* str, utf32_t codepoint) {
+    utf8_t needle[5] = { 0 };
+    size_t n = utf8_encode(needle, 4, codepoint);
+    // the null terminator can't be found with a null terminated needle.
+    if (n == UNICODE_INVALID_CODEPOINT || codepoint == 0 || !utf8_is_valid64(needle, n)) return UTF8_NOT_FOUND;
+    size_t found = utf8_find_bytes_nt(str, needle);
+
+    // the single byte `F8` decodes as U+00F8 too, `UTF8_NOT_FOUND` is greater than any index.
+    if (codepoint == 0xF8) {
+        size_t raw = utf8_find_bytes_nt(str, UTF8_CAST("\xF8"));
+        found = raw < found ? raw : found;
+    }
+    return found;
+}
+
+size_t utf8_find_char_index(const utf8_t* str, size_t len, utf32_t codepoint) {
+    size_t found = utf8_find_char(str, len, codepoint);
+    return found == UTF8_NOT_FOUND ? UTF8_NOT_FOUND : utf8_count64(str, found);
+}
+
+size_t utf8_find_substring(const utf8_t* str, size_t len, const utf8_t* substr, size_t sublen) {
+    return utf8_find_bytes(str, len, substr, sublen);
+}
+
+size_t utf8_find_substring_nt(const utf8_t* str, const utf8_t* substr) {
+    return utf8_find_bytes_nt(str, substr);
+}
+
+size_t utf8_find_substring_index(const utf8_t* str, size_t len, const utf8_t* substr, size_t sublen) {
+    size_t found = utf8_find_substring(str, len, substr, sublen);
+    return found == UTF8_NOT_FOUND ? UTF8_NOT_FOUND : utf8_count64(str, found);
+}
+
+// byte index of the first difference between two strings of `len` bytes, or `len` if they're the same.
+static inline size_t utf8_mismatch(const utf8_t* lhs, const utf8_t* rhs, size_t len) {
+    size_t i = utf8_mismatch_blocks(lhs, rhs, len);
+    while (i < len && lhs[i] == rhs[i]) i++;
+    return i;
+}
+
+int utf8_cmp_prefix(const utf8_t* lhs, size_t lhs_len, const utf8_t* rhs, size_t rhs_len, size_t* prefix) {
+    // `i` and `j` are where the next characters start, everything before `common` is identical in both strings.
+    size_t i = 0, j = 0, common = 0;
+    size_t len = lhs_len < rhs_len ? lhs_len : rhs_len;
+    while (true) {
+        if (i == common) {
+            // skip the identical bytes, then go back to the start of the character the difference is in.
+            // every head byte starts a character, and the characters before it are the same in both strings.
+            size_t mismatch = i + utf8_mismatch(lhs + i, rhs + i, len - i);
+            if (mismatch == lhs_len && mismatch == rhs_len) {
+                *prefix = mismatch;
+                return 0;
+            }
+            i = j = common = i + utf8_char_boundary(lhs + i, mismatch - i);
+        }
+
+        if (i == lhs_len || j == rhs_len) {
+            *prefix = common;
+            return (i != lhs_len) - (j != rhs_len);
+        }
+
+        decoded_utf8_t l = utf8_decode_dfa(lhs + i, lhs_len - i, false);
+        decoded_utf8_t r = utf8_decode_dfa(rhs + j, rhs_len - j, false);
+        if (l.codepoint != r.codepoint) {
+            *prefix = common;
+            return l.codepoint < r.codepoint ? -1 : 1;
+        }
+
+        // the same codepoint from different bytes is U+FFFD against a malformed byte, which ends the common prefix.
+        if (i == common && l.len == r.len && lhs[i] == rhs[j]) {
+            common += l.len;
+        }
+        i += l.len;
+        j += r.len;
+    }
+}
+
+int utf8_cmp(const utf8_t* lhs, size_t lhs_len, const utf8_t* rhs, size_t rhs_len) {
+    size_t prefix;
+    return utf8_cmp_prefix(lhs, lhs_len, rhs, rhs_len, &prefix);
+}
+
+int utf8_cmp_nt(const utf8_t* lhs, const utf8_t* rhs) {
+    size_t i = 0, j = 0;
+    while (true) {
+        if (i == j) {
+            size_t mismatch = i;
+            while (lhs[mismatch] && lhs[mismatch] == rhs[mismatch]) mismatch++;
+            if (!lhs[mismatch] && !rhs[mismatch]) {
+                return 0;
+            }
+            i = j = i + utf8_char_boundary(lhs + i, mismatch - i);
+        }
+
+        if (!lhs[i] || !rhs[j]) {
+            return (lhs[i] != 0) - (rhs[j] != 0);
+        }
+
+        decoded_utf8_t l = utf8_decode_dfa(lhs + i, 4, true);
+        decoded_utf8_t r = utf8_decode_dfa(rhs + j, 4, true);
+        if (l.codepoint != r.codepoint) {
+            return l.codepoint < r.codepoint ? -1 : 1;
+        }
+        i += l.len;
+        j += r.len;
+    }
+}
+
+size_t utf8_index_capacity(size_t len, size_t stride) {
+    // there are at most `len` characters, and a checkpoint at the start of each stride.
+    return len / stride + (len % stride != 0);
+}
+
+bool utf8_index_build(utf8_index_t* index, const utf8_t* str, size_t len, size_t stride, size_t* checkpoints, size_t cap) {
+    if (stride == 0 || cap < utf8_index_capacity(len, stride)) {
+        return false;
+    }
+    index->str = str;
+    index->len = len;
+    index->stride = stride;
+    index->checkpoints = checkpoints;
+    index->n = 0;
+
+    size_t i = 0, c = 0;
+    while (i < len) {
+        // checkpoint heads a block at a time until a block has an error or there are no whole blocks left.
+        size_t first = index->n;
+        size_t stop = i + utf8_index_blocks(str + i, len - i, &c, index);
+        for (size_t k = first; k < index->n; k++) {
+            checkpoints[k] += i;
+        }
+
+        // as in `utf8_count` the scalar loop restarts from a head the blocks have counted, and may have checkpointed.
+        size_t restart = i + utf8_char_boundary(str + i, stop - i);
+        if (restart < stop) {
+            c--;
+            index->n -= index->n > 0 && checkpoints[index->n - 1] == restart;
+        }
+
+        size_t end = stop + UTF8_BLOCK_SIZE < len ? stop + UTF8_BLOCK_SIZE : len;
+        size_t next = index->n * stride;
+        for (i = restart; i < end; c++) {
+            if (c == next) {
+                checkpoints[index->n++] = i;
+                next += stride;
+            }
+            i += utf8_decode_dfa(&str[i], len - i, false).len;
+        }
+    }
+    index->count = c;
+    return true;
+}
+
+size_t utf8_index_codepoint_to_byte(const utf8_index_t* index, size_t codepoint) {
+    if (codepoint >= index->count) {
+        return codepoint == index->count ? index->len : UTF8_NOT_FOUND;
+    }
+    size_t i = index->checkpoints[codepoint / index->stride];
+    for (size_t c = codepoint % index->stride; c > 0; c--) {
+        i += utf8_decode_dfa(index->str + i, index->len - i, false).len;
+    }
+    return i;
+}
+
+size_t utf8_index_byte_to_codepoint(const utf8_index_t* index, size_t byte) {
+    if (byte >= index->len) {
+        return byte == index->len ? index->count : UTF8_NOT_FOUND;
+    }
+    // the last checkpoint at or before `byte`, the first is always at 0.
+    size_t low = 0, high = index->n;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (index->checkpoints[mid] <= byte) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    size_t i = index->checkpoints[low], c = low * index->stride;
+    while (true) {
+        size_t next = i + utf8_decode_dfa(index->str + i, index->len - i, false).len;
+        if (next > byte) {
+            return c;
+        }
+        i = next;
+        c++;
+    }
+}
+
+// bytes of the data buffer the batch functions validate at a time, small enough to still be in cache
+// when the strings in it are counted.
+#define UTF8_BATCH_RUN_SIZE 4096
+
+// gets offset `k` from either width of offsets.
+static inline size_t utf8_batch_offset(const void* offsets, bool wide, size_t k) {
+    return wide ? (size_t)((const int64_t*)offsets)[k] : (size_t)((const int32_t*)offsets)[k];
+}
+
+// counts the bytes that aren't continuations, a fixed number at a time so compilers vectorize it.
+static inline size_t utf8_count_heads(const utf8_t* str, size_t len) {
+    size_t i = 0, c = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint32_t heads = 0;
+        for (size_t k = 0; k < 16; k++) {
+            heads += (int8_t)str[i + k] > (int8_t)0xBF;
+        }
+        c += heads;
+    }
+    for (; i < len; i++) {
+        c += (int8_t)str[i] > (int8_t)0xBF;
+    }
+    return c;
+}
+
+// checks strings `[0, n)` of an offsets array, setting bit `first + k` of `valid` for each valid string `k`,
+// `valid` must already be cleared.
+static size_t utf8_batch_offsets(const utf8_t* data, const void* offsets, bool wide, size_t n, uint8_t* valid, size_t first, size_t* counts) {
+    size_t invalid = 0;
+    size_t total = utf8_batch_offset(offsets, wide, n);
+    size_t k = 0;
+    while (k < n) {
+        size_t pos = utf8_batch_offset(offsets, wide, k);
+        size_t run_end = total - pos < UTF8_BATCH_RUN_SIZE ? total : pos + UTF8_BATCH_RUN_SIZE;
+        size_t stop = pos + utf8_validate_blocks(data + pos, run_end - pos);
+        // every character before `trusted` is whole and valid.
+        size_t trusted = pos + utf8_char_boundary(data + pos, stop - pos);
+
+        // a string in the trusted bytes is valid if it starts on a head and the next string does too,
+        // a string ending at `trusted` ends with the last whole character.
+        size_t start = pos;
+        for (; k < n; k++) {
+            size_t end = utf8_batch_offset(offsets, wide, k + 1);
+            if (end > trusted) break;
+            bool ok = start == end || (!utf8_is_continuation(data[start]) && (end == trusted || !utf8_is_continuation(data[end])));
+            if (ok) {
+                valid[(first + k) >> 3] |= (uint8_t)(1 << ((first + k) & 7));
+            } else {
+                invalid++;
+            }
+            if (counts) {
+                counts[k] = ok ? utf8_count_heads(data + start, end - start) : utf8_count64(data + start, end - start);
+            }
+            start = end;
+        }
+
+        // the string cut by the end of the trusted bytes is checked on its own if no string ended before it,
+        // either it's longer than a run or it's next to an error, then the blocks restart after it.
+        if (k < n && start == pos) {
+            size_t end = utf8_batch_offset(offsets, wide, k + 1);
+            if (utf8_is_valid_string64(data + start, end - start)) {
+                valid[(first + k) >> 3] |= (uint8_t)(1 << ((first + k) & 7));
+            } else {
+                invalid++;
+            }
+            if (counts) {
+                counts[k] = utf8_count64(data + start, end - start);
+            }
+            k++;
+        }
+    }
+    return invalid;
+}
+
+// clears the bytes of a bitmap of `n` bits.
+static void utf8_bitmap_clear(uint8_t* bitmap, size_t n) {
+    for (size_t i = 0; i < (n + 7) / 8; i++) {
+        bitmap[i] = 0;
+    }
+}
+
+size_t utf8_validate_offsets(const utf8_t* data, const int32_t* offsets, size_t n, uint8_t* valid, size_t* counts) {
+    utf8_bitmap_clear(valid, n);
+    return utf8_batch_offsets(data, offsets, false, n, valid, 0, counts);
+}
+
+size_t utf8_validate_offsets64(const utf8_t* data, const int64_t* offsets, size_t n, uint8_t* valid, size_t* counts) {
+    utf8_bitmap_clear(valid, n);
+    return utf8_batch_offsets(data, offsets, true, n, valid, 0, counts);
+}
+
+size_t utf8_validate_batch(const utf8_span_t* strings, size_t n, uint8_t* valid, size_t* counts) {
+    utf8_t packed[UTF8_BATCH_PACKED_SIZE];
+    int32_t offsets[UTF8_BATCH_PACKED_STRINGS + 1];
+    size_t invalid = 0;
+    utf8_bitmap_clear(valid, n);
+
+    size_t k = 0;
+    while (k < n) {
+        // copy strings together until the buffer is full.
+        size_t first = k, len = 0, m = 0;
+        offsets[0] = 0;
+        while (k < n && m < UTF8_BATCH_PACKED_STRINGS && strings[k].len <= UTF8_BATCH_MAX_PACKED &&
+               len + strings[k].len <= UTF8_BATCH_PACKED_SIZE) {
+            utf8_copy(packed + len, strings[k].str, strings[k].len);
+            len += strings[k].len;
+            offsets[++m] = (int32_t)len;
+            k++;
+        }
+        if (m > 0) {
+            invalid += utf8_batch_offsets(packed, offsets, false, m, valid, first, counts ? counts + first : NULL);
+            continue;
+        }
+
+        // too long to be worth copying.
+        if (utf8_is_valid_string64(strings[k].str, strings[k].len)) {
+            valid[k >> 3] |= (uint8_t)(1 << (k & 7));
+        } else {
+            invalid++;
+        }
+        if (counts) {
+            counts[k] = utf8_count64(strings[k].str, strings[k].len);
+        }
+        k++;
+    }
+    return invalid;
+}
+
+// a string split into chunks for the `_parallel` functions, with each chunk's partial result.
+typedef struct utf8_parallel_job_t {
+    const utf8_t* str;
+    // chunk `k` is the bytes from `starts[k]` to `starts[k + 1]`.
+    size_t starts[UTF8_PARALLEL_MAX_CHUNKS + 1];
+    size_t results[UTF8_PARALLEL_MAX_CHUNKS];
+    // where each chunk's codepoints go, for decoding.
+    utf32_t* dst;
+    size_t offsets[UTF8_PARALLEL_MAX_CHUNKS];
+    size_t caps[UTF8_PARALLEL_MAX_CHUNKS];
+} utf8_parallel_job_t;
+
+// moves `idx` back to the start of a character in the serial walk, looking at most 3 bytes back.
+// Every head byte starts a character, and if none of the 4 bytes up to `idx` is a head
+// no character can cover `idx`, since the longest is 4 bytes.
+static size_t utf8_resync(const utf8_t* str, size_t idx) {
+    for (size_t back = 0; back <= 3 && back <= idx; back++) {
+        if (!utf8_is_continuation(str[idx - back])) {
+            return idx - back;
+        }
+    }
+    return idx;
+}
+
+// splits the string into chunks, returning how many.
+static size_t utf8_parallel_split(utf8_parallel_job_t* job, const utf8_t* str, size_t len, const utf8_parallel_t* parallel) {
+    size_t n = parallel->chunks;
+    if (n > len / UTF8_PARALLEL_MIN_CHUNK) n = len / UTF8_PARALLEL_MIN_CHUNK;
+    if (n > UTF8_PARALLEL_MAX_CHUNKS) n = UTF8_PARALLEL_MAX_CHUNKS;
+    if (n < 1) n = 1;
+
+    job->str = str;
+    job->starts[0] = 0;
+    for (size_t k = 1; k < n; k++) {
+        job->starts[k] = utf8_resync(str, len / n * k);
+    }
+    job->starts[n] = len;
+    return n;
+}
+
+static void utf8_parallel_run(const utf8_parallel_t* parallel, void (*task)(void* job, size_t chunk), utf8_parallel_job_t* job, size_t n) {
+    if (parallel->run && n > 1) {
+        parallel->run(parallel->pool, task, job, n);
+        return;
+    }
+    for (size_t k = 0; k < n; k++) {
+        task(job, k);
+    }
+}
+
+static void utf8_validate_task(void* arg, size_t k) {
+    utf8_parallel_job_t* job = (utf8_parallel_job_t*)arg;
+    job->results[k] = utf8_is_valid_string64(job->str + job->starts[k], job->starts[k + 1] - job->starts[k]);
+}
+
+static void utf8_count_task(void* arg, size_t k) {
+    utf8_parallel_job_t* job = (utf8_parallel_job_t*)arg;
+    job->results[k] = utf8_count64(job->str + job->starts[k], job->starts[k + 1] - job->starts[k]);
+}
+
+static void utf8_decode_task(void* arg, size_t k) {
+    utf8_parallel_job_t* job = (utf8_parallel_job_t*)arg;
+    job->results[k] = utf8_decode_string(job->str + job->starts[k], job->starts[k + 1] - job->starts[k], job->dst + job->offsets[k], job->caps[k]).read;
+}
+
+bool utf8_is_valid_string_parallel(const utf8_t* utf8, size_t len, const utf8_parallel_t* parallel) {
+    utf8_parallel_job_t job;
+    size_t n = utf8_parallel_split(&job, utf8, len, parallel);
+    utf8_parallel_run(parallel, utf8_validate_task, &job, n);
+    bool valid = true;
+    for (size_t k = 0; k < n; k++) {
+        valid &= job.results[k] != 0;
+    }
+    return valid;
+}
+
+size_t utf8_count_parallel(const utf8_t* str, size_t len, const utf8_parallel_t* parallel) {
+    utf8_parallel_job_t job;
+    size_t n = utf8_parallel_split(&job, str, len, parallel);
+    utf8_parallel_run(parallel, utf8_count_task, &job, n);
+    size_t count = 0;
+    for (size_t k = 0; k < n; k++) {
+        count += job.results[k];
+    }
+    return count;
+}
+
+transcoded_t utf8_decode_string_parallel(const utf8_t* src, size_t len, utf32_t* dst, size_t dst_cap, const utf8_parallel_t* parallel) {
+    utf8_parallel_job_t job;
+    size_t n = utf8_parallel_split(&job, src, len, parallel);
+    utf8_parallel_run(parallel, utf8_count_task, &job, n);
+
+    // each chunk writes after the codepoints of the chunks before it, as much as fits.
+    job.dst = dst;
+    size_t written = 0;
+    for (size_t k = 0; k < n; k++) {
+        job.offsets[k] = written;
+        job.caps[k] = dst_cap - written < job.results[k] ? dst_cap - written : job.results[k];
+        written += job.caps[k];
+    }
+    utf8_parallel_run(parallel, utf8_decode_task, &job, n);
+
+    // read up to the first chunk that didn't fit.
+    size_t read = 0;
+    for (size_t k = 0; k < n; k++) {
+        read += job.results[k];
+        if (job.results[k] < job.starts[k + 1] - job.starts[k]) break;
+    }
+    return TRANSCODED_LITERAL(read, written);
+}
+
+transcoded_t utf8_encode_string(const utf32_t* src, size_t n, utf8_t* dst, size_t cap) {
+    size_t w = 0;
+    size_t i = utf8_encode_blocks(src, n, dst, cap, &w);
+    while (i < n) {
+        size_t utf8_len = utf8_encode(dst + w, cap - w, src[i]);
+        if (utf8_len == 0 || utf8_len == UNICODE_INVALID_CODEPOINT) {
+            break;
+        }
+        w += utf8_len;
+        i++;
+    }
+    return TRANSCODED_LITERAL(i, w);
+}
+
 size_t utf8_encode_nt(utf8_t* buffer, size_t len, utf32_t codepoint) {
 
 
@@ -625,4 +3369,183 @@ size_t utf8_encode_nt(utf8_t* buffer, size_t len, utf32_t codepoint) {
     return utf8_len;
 }
 
+
+
+static transcoded_t utf8_to_utf16_endian(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool lossy, bool big_endian) {
+    size_t i = 0, w = 0;
+    while (i < len) {
+        size_t written = 0;
+        i += utf8_to_utf16_blocks(src + i, len - i, dst + w, dst_cap - w, big_endian, &written);
+        w += written;
+
+        // one character at a time through a block with errors, or the tail.
+        size_t end = i + 16 < len ? i + 16 : len;
+        while (i < end) {
+            decoded_utf8_t decoded = utf8_decode(src + i, len - i);
+            if (decoded.codepoint == UNICODE_REPLACEMENT_CHAR && decoded.len == 1 && !lossy) {
+                return TRANSCODED_LITERAL(i, w);
+            }
+            if (w + 1 + (decoded.codepoint > 0xFFFF) > dst_cap) {
+                return TRANSCODED_LITERAL(i, w);
+            }
+            if (decoded.codepoint > 0xFFFF) {
+                w += utf16_store_codepoint(dst + w, decoded.codepoint, big_endian);
+            } else {
+                utf16_store(dst + w++, (utf16_t)decoded.codepoint, big_endian);
+            }
+            i += decoded.len;
+        }
+    }
+    return TRANSCODED_LITERAL(i, w);
+}
+
+transcoded_t utf8_to_utf16le(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool lossy) {
+    return utf8_to_utf16_endian(src, len, dst, dst_cap, lossy, false);
+}
+
+transcoded_t utf8_to_utf16be(const utf8_t* src, size_t len, utf16_t* dst, size_t dst_cap, bool lossy) {
+    return utf8_to_utf16_endian(src, len, dst, dst_cap, lossy, true);
+}
+
+static transcoded_t utf16_endian_to_utf8(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool lossy, bool big_endian) {
+    size_t i = 0, w = 0;
+    while (i < n) {
+        size_t written = 0;
+        i += utf16_to_utf8_blocks(src + i, n - i, dst + w, dst_cap - w, big_endian, &written);
+        w += written;
+
+        // one character at a time through a block with surrogates, or the tail.
+        size_t end = i + 16 < n ? i + 16 : n;
+        while (i < end) {
+            utf16_t unit = utf16_load(src + i, big_endian);
+            utf16_t next = i + 1 < n ? utf16_load(src + i + 1, big_endian) : 0;
+
+            // a high surrogate followed by a low surrogate.
+            bool pair = (unit & 0xFC00) == 0xD800 && (next & 0xFC00) == 0xDC00;
+            utf32_t codepoint = pair ? 0x10000 + ((utf32_t)(unit - 0xD800) << 10) + (utf32_t)(next - 0xDC00) : unit;
+
+            if (!pair && (unit & 0xF800) == 0xD800) {
+                if (!lossy) {
+                    return TRANSCODED_LITERAL(i, w);
+                }
+                codepoint = UNICODE_REPLACEMENT_CHAR;
+            }
+
+            size_t utf8_len = utf8_encode(dst + w, dst_cap - w, codepoint);
+            if (utf8_len == 0) {
+                return TRANSCODED_LITERAL(i, w);
+            }
+            w += utf8_len;
+            i += 1 + pair;
+        }
+    }
+    return TRANSCODED_LITERAL(i, w);
+}
+
+transcoded_t utf16le_to_utf8(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool lossy) {
+    return utf16_endian_to_utf8(src, n, dst, dst_cap, lossy, false);
+}
+
+transcoded_t utf16be_to_utf8(const utf16_t* src, size_t n, utf8_t* dst, size_t dst_cap, bool lossy) {
+    return utf16_endian_to_utf8(src, n, dst, dst_cap, lossy, true);
+}
+
+size_t utf8_utf32_length(const utf8_t* src, size_t len) {
+    return utf8_count64(src, len);
+}
+
+// counts the utf16 units of valid utf8, 256 bytes at a time,
+// few enough that compilers vectorize the loop rather than unrolling it.
+// `F8` is a single byte character, and the other `F5` to `FF` bytes don't appear in valid utf8.
+static inline size_t utf8_utf16_units(const utf8_t* str, size_t len) {
+    size_t i = 0, c = 0;
+    for (; i + 256 <= len; i += 256) {
+        uint32_t units = 0;
+        for (size_t k = 0; k < 256; k++) {
+            units += ((int8_t)str[i + k] > (int8_t)0xBF) + ((str[i + k] & 0xF8) == 0xF0);
+        }
+        c += units;
+    }
+    for (; i < len; i++) {
+        c += ((int8_t)str[i] > (int8_t)0xBF) + ((str[i] & 0xF8) == 0xF0);
+    }
+    return c;
+}
+
+size_t utf8_utf16_length(const utf8_t* src, size_t len) {
+    size_t i = 0, c = 0;
+    while (i < len) {
+        // validate a run at a time like the batch functions, so the bytes are still in cache when they are counted.
+        size_t run_end = len - i > UTF8_BATCH_RUN_SIZE ? i + UTF8_BATCH_RUN_SIZE : len;
+        size_t stop = i + utf8_validate_blocks(src + i, run_end - i);
+        size_t restart = i + utf8_char_boundary(src + i, stop - i);
+        c += utf8_utf16_units(src + i, restart - i);
+        i = restart;
+
+        // count through the failing block, or the tail, one character at a time.
+        // a run that is valid up to its last partial block carries on with blocks from the last head instead.
+        size_t end = stop + UTF8_BLOCK_SIZE <= run_end ? stop + UTF8_BLOCK_SIZE : run_end == len ? len : i;
+        while (i < end) {
+            decoded_utf8_t decoded = utf8_decode_dfa(&src[i], len - i, false);
+            c += 1 + (decoded.codepoint > 0xFFFF);
+            i += decoded.len;
+        }
+    }
+    return c;
+}
+
+size_t utf32_utf8_length(const utf32_t* src, size_t n) {
+    size_t i = 0, c = 0;
+    // 256 codepoints at a time so compilers vectorize it, like `utf8_utf16_units`.
+    // 1 to 4 bytes by the thresholds the codepoint passes, invalid codepoints pass all of them and lose one for U+FFFD.
+    for (; i + 256 <= n; i += 256) {
+        uint32_t bytes = 0;
+        for (size_t k = 0; k < 256; k++) {
+            utf32_t cp = src[i + k];
+            bytes += 1 + (cp > 0x7F) + (cp > 0x7FF) + (cp > 0xFFFF) - (cp > 0x10FFFF);
+        }
+        c += bytes;
+    }
+    for (; i < n; i++) {
+        utf32_t cp = src[i];
+        c += 1 + (cp > 0x7F) + (cp > 0x7FF) + (cp > 0xFFFF) - (cp > 0x10FFFF);
+    }
+    return c;
+}
+
+// every unit is 1 to 3 bytes on its own, which counts unpaired surrogates as U+FFFD,
+// and a high surrogate followed by a low surrogate is 4 bytes together rather than 6.
+static inline size_t utf16_endian_utf8_length(const utf16_t* src, size_t n, bool big_endian) {
+    size_t i = 0, c = 0;
+    // 256 units at a time so compilers vectorize it, each looking at the unit after it.
+    // the byte order is a shift by the same amount for every unit rather than a choice of load, which doesn't vectorize.
+    const utf8_t* in = (const utf8_t*)src;
+    unsigned first = big_endian ? 8 : 0, second = 8 - first;
+    for (; i + 257 <= n; i += 256) {
+        uint32_t bytes = 0;
+        for (size_t k = 0; k < 256; k++) {
+            utf16_t unit = (utf16_t)(in[2 * (i + k)] << first | in[2 * (i + k) + 1] << second);
+            utf16_t next = (utf16_t)(in[2 * (i + k) + 2] << first | in[2 * (i + k) + 3] << second);
+            bytes += 1 + (unit > 0x7F) + (unit > 0x7FF);
+            bytes -= 2 * (((unit & 0xFC00) == 0xD800) & ((next & 0xFC00) == 0xDC00));
+        }
+        c += bytes;
+    }
+    for (; i < n; i++) {
+        utf16_t unit = utf16_load(src + i, big_endian);
+        utf16_t next = i + 1 < n ? utf16_load(src + i + 1, big_endian) : 0;
+        c += 1 + (unit > 0x7F) + (unit > 0x7FF);
+        c -= 2 * (((unit & 0xFC00) == 0xD800) & ((next & 0xFC00) == 0xDC00));
+    }
+    return c;
+}
+
+size_t utf16le_utf8_length(const utf16_t* src, size_t n) {
+    return utf16_endian_utf8_length(src, n, false);
+}
+
+size_t utf16be_utf8_length(const utf16_t* src, size_t n) {
+    return utf16_endian_utf8_length(src, n, true);
+}
+
 #endif  // UNICODE_IMPL
\ No newline at end of file
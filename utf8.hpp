@@ -0,0 +1,385 @@
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+// C++ companion to `unicode.h`, with `constexpr` versions of the single character and whole string functions,
+// so constant strings can be checked and counted at compile time.
+// They follow exactly the same rules as the C functions of the same name, without calling them,
+// and can be used without defining `UNICODE_IMPL`.
+// Needs C++17, `utf8_literal`, the `_utf8` literal, `codepoint_view` and `validated_utf8` need C++20.
+
+#include "unicode.h"
+
+#if __cplusplus >= 202002L
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <string_view>
+#include <type_traits>
+#endif
+
+namespace utf8 {
+
+/// @brief `constexpr` version of `utf8_is_continuation`.
+/// @param byte the byte to check.
+/// @return `true` if it is a continuation byte `0b10xxxxxx`, `false` if not.
+constexpr bool is_continuation(utf8_t byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+/// @brief `constexpr` version of `utf8_is_valid_head`.
+/// @param byte the byte to check.
+/// @return `true` if it can start a character, `false` if not.
+constexpr bool is_valid_head(utf8_t byte) {
+    return byte <= 0xF8 && !is_continuation(byte);
+}
+
+/// @brief `constexpr` version of `utf8_length`, gets the length of the character from its head byte.
+/// @param head the head byte of the utf8 encoded character
+/// @return the length of the character in bytes, 1 if it is invalid.
+constexpr uint32_t length(utf8_t head) {
+    if ((head & 0x80) == 0x00) return 1;
+    if ((head & 0xE0) == 0xC0) return 2;
+    if ((head & 0xF0) == 0xE0) return 3;
+    if ((head & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+/// @brief `constexpr` version of `utf8_codepoint_length`.
+/// @param codepoint
+/// @return the length of the utf8 encoding in bytes, `UNICODE_INVALID_CODEPOINT` if the codepoint is invalid.
+constexpr uint32_t codepoint_length(utf32_t codepoint) {
+    if (codepoint < 0x80) return 1;
+    if (codepoint < 0x800) return 2;
+    if (codepoint < 0x10000) return 3;
+    if (codepoint < 0x110000) return 4;
+    return UNICODE_INVALID_CODEPOINT;
+}
+
+/// @brief `constexpr` version of `utf8_is_valid`, checks if a single character is completely valid.
+/// @param str pointer to the first byte of the utf8 encoded character, `char`, `char8_t` or `utf8_t`
+/// @param len length of the buffer the character is stored in
+/// @return `true` if the character is a valid utf8 encoding, `false` if not.
+template <typename Char>
+constexpr bool is_valid(const Char* str, size_t len) {
+    static_assert(sizeof(Char) == 1, "utf8 strings are made of bytes");
+    utf8_t b0 = static_cast<utf8_t>(str[0]);
+    if (!is_valid_head(b0)) return false;
+
+    uint32_t utf8_len = length(b0);
+    if (utf8_len > len) return false;
+    for (uint32_t i = 1; i < utf8_len; i++) {
+        if (!is_continuation(static_cast<utf8_t>(str[i]))) return false;
+    }
+    if (utf8_len == 1) return true;
+
+    // the same overlong and oversize checks as `utf8_is_overlong_encoding` and `utf8_is_oversize_codepoint`.
+    utf8_t b1 = static_cast<utf8_t>(str[1]);
+    if (utf8_len == 2) return (b0 & 0x1E) != 0;
+    if (utf8_len == 3) return (b0 & 0x0F) != 0 || (b1 & 0x40) != 0;
+    bool overlong = !(b0 & 0x07) && !(b1 & 0x50);
+    bool oversize = (b0 & 0x04) && ((b0 & 0x03) || (b1 & 0x30));
+    return !overlong && !oversize;
+}
+
+/// @brief `constexpr` version of `utf8_decode`, decodes a single character from the string.
+/// If it isn't a valid utf8 encoding it returns the replacement character U+FFFD "�" and a length of 1.
+/// @param str pointer to the first byte of the utf8 encoded character, `char`, `char8_t` or `utf8_t`
+/// @param len length of the buffer the character is stored in
+/// @return the codepoint and the number of bytes decoded.
+template <typename Char>
+constexpr decoded_utf8_t decode(const Char* str, size_t len) {
+    if (!is_valid(str, len)) return decoded_utf8_t{ UNICODE_REPLACEMENT_CHAR, 1 };
+
+    utf8_t b0 = static_cast<utf8_t>(str[0]);
+    uint32_t utf8_len = length(b0);
+    if (utf8_len == 1) return decoded_utf8_t{ b0, 1 };
+
+    utf32_t codepoint = b0 & (0x7F >> utf8_len);
+    for (uint32_t i = 1; i < utf8_len; i++) {
+        codepoint = (codepoint << 6) | (static_cast<utf8_t>(str[i]) & 0x3F);
+    }
+    return decoded_utf8_t{ codepoint, utf8_len };
+}
+
+/// @brief `constexpr` version of `utf8_encode`, encodes a codepoint into the buffer.
+/// @param buffer where to write the utf8 encoding, `char`, `char8_t` or `utf8_t`
+/// @param len the space in the buffer in bytes
+/// @param codepoint
+/// @return the number of bytes written, 0 if there isn't enough space, `UNICODE_INVALID_CODEPOINT` if the codepoint is invalid.
+template <typename Char>
+constexpr size_t encode(Char* buffer, size_t len, utf32_t codepoint) {
+    static_assert(sizeof(Char) == 1, "utf8 strings are made of bytes");
+    uint32_t utf8_len = codepoint_length(codepoint);
+    if (utf8_len == UNICODE_INVALID_CODEPOINT) return UNICODE_INVALID_CODEPOINT;
+    if (utf8_len > len) return 0;
+    if (utf8_len == 1) {
+        buffer[0] = static_cast<Char>(codepoint);
+        return 1;
+    }
+
+    for (uint32_t i = utf8_len - 1; i > 0; i--) {
+        buffer[i] = static_cast<Char>((codepoint & 0x3F) | 0x80);
+        codepoint >>= 6;
+    }
+    buffer[0] = static_cast<Char>(static_cast<utf8_t>(0xF0 << (4 - utf8_len)) | codepoint);
+    return utf8_len;
+}
+
+/// @brief `constexpr` version of `utf8_count64`, counts the characters in a string, including errors.
+/// @param str the utf8 encoded string, `char`, `char8_t` or `utf8_t`
+/// @param len the length of the string in bytes
+/// @return the number of separate utf8 characters, each malformed byte counting as one.
+template <typename Char>
+constexpr size_t count(const Char* str, size_t len) {
+    size_t c = 0;
+    for (size_t i = 0; i < len; c++) {
+        i += decode(str + i, len - i).len;
+    }
+    return c;
+}
+
+/// @brief `constexpr` version of `utf8_is_valid_string64`, checks if every character in the string is a valid utf8 encoding.
+/// @param str the utf8 encoded string, `char`, `char8_t` or `utf8_t`
+/// @param len the length of the string in bytes
+/// @return `true` if the string is valid utf8, `false` if not.
+template <typename Char>
+constexpr bool is_valid_string(const Char* str, size_t len) {
+    for (size_t i = 0; i < len; i += length(static_cast<utf8_t>(str[i]))) {
+        if (!is_valid(str + i, len - i)) return false;
+    }
+    return true;
+}
+
+#if __cplusplus >= 202002L
+
+/// @brief iterates over the codepoints of a utf8 string, a bidirectional iterator for `std::ranges` algorithms.
+/// With `Valid` the string must be known to be valid utf8, e.g. from a `validated_utf8`,
+/// and it steps like `utf8_next_char_unsafe` without any checks, holding only a pointer.
+/// Otherwise it steps like `utf8_next_char` and `utf8_prev_char`, each malformed byte is U+FFFD.
+template <bool Valid>
+class codepoint_iterator {
+public:
+    using value_type = utf32_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::bidirectional_iterator_tag;
+    // codepoints are decoded into values, so to older algorithms it is only an input iterator.
+    using iterator_category = std::input_iterator_tag;
+
+    constexpr codepoint_iterator() = default;
+
+    constexpr codepoint_iterator(const utf8_t* pos, const utf8_t* begin, const utf8_t* end)
+        : pos_(pos), bounds_{ begin, end } {}
+
+    constexpr utf32_t operator*() const {
+        if constexpr (Valid) {
+            uint32_t utf8_len = length(pos_[0]);
+            if (utf8_len == 1) return pos_[0];
+            utf32_t codepoint = pos_[0] & (0x7F >> utf8_len);
+            for (uint32_t i = 1; i < utf8_len; i++) {
+                codepoint = (codepoint << 6) | (pos_[i] & 0x3F);
+            }
+            return codepoint;
+        } else {
+            return decode(pos_, static_cast<size_t>(bounds_.end - pos_)).codepoint;
+        }
+    }
+
+    constexpr codepoint_iterator& operator++() {
+        if constexpr (Valid) {
+            pos_ += length(pos_[0]);
+        } else {
+            pos_ += decode(pos_, static_cast<size_t>(bounds_.end - pos_)).len;
+        }
+        return *this;
+    }
+
+    constexpr codepoint_iterator operator++(int) {
+        codepoint_iterator before = *this;
+        ++*this;
+        return before;
+    }
+
+    constexpr codepoint_iterator& operator--() {
+        if constexpr (Valid) {
+            do {
+                pos_--;
+            } while (is_continuation(pos_[0]));
+        } else {
+            // the same as `utf8_prev_char`, only a valid character from a head in the 4 bytes before ends here.
+            size_t idx = static_cast<size_t>(pos_ - bounds_.begin);
+            for (size_t back = 1; back <= 4 && back <= idx; back++) {
+                if (!is_continuation(pos_[-static_cast<std::ptrdiff_t>(back)])) {
+                    const utf8_t* head = pos_ - back;
+                    if (decode(head, static_cast<size_t>(bounds_.end - head)).len != back) break;
+                    pos_ = head;
+                    return *this;
+                }
+            }
+            pos_--;
+        }
+        return *this;
+    }
+
+    constexpr codepoint_iterator operator--(int) {
+        codepoint_iterator before = *this;
+        --*this;
+        return before;
+    }
+
+    constexpr bool operator==(const codepoint_iterator& other) const {
+        return pos_ == other.pos_;
+    }
+
+    /// @return pointer to the first byte of the current character.
+    constexpr const utf8_t* base() const { return pos_; }
+
+private:
+    struct unbounded {
+        constexpr unbounded(const utf8_t*, const utf8_t*) {}
+        constexpr unbounded() = default;
+    };
+    struct bounded {
+        const utf8_t* begin = nullptr;
+        const utf8_t* end = nullptr;
+    };
+
+    const utf8_t* pos_ = nullptr;
+    // only the checked iterator needs the ends of the string, to not decode or step back past them.
+    [[no_unique_address]] std::conditional_t<Valid, unbounded, bounded> bounds_;
+};
+
+/// @brief the codepoints of a utf8 string as a range, e.g. `for (utf32_t c : utf8::codepoint_view(text))`.
+/// Malformed bytes are U+FFFD, one for each byte, the same as `utf8_decode`.
+/// The view from `validated_utf8::codepoints` skips those checks.
+template <bool Valid>
+class basic_codepoint_view : public std::ranges::view_interface<basic_codepoint_view<Valid>> {
+public:
+    using iterator = codepoint_iterator<Valid>;
+
+    constexpr basic_codepoint_view() = default;
+
+    constexpr basic_codepoint_view(const utf8_t* str, size_t len)
+        : begin_(str), end_(str + len) {}
+
+    constexpr basic_codepoint_view(std::string_view str) requires(!Valid)
+        : basic_codepoint_view(reinterpret_cast<const utf8_t*>(str.data()), str.size()) {}
+
+    constexpr iterator begin() const { return iterator(begin_, begin_, end_); }
+    constexpr iterator end() const { return iterator(end_, begin_, end_); }
+
+private:
+    const utf8_t* begin_ = nullptr;
+    const utf8_t* end_ = nullptr;
+};
+
+using codepoint_view = basic_codepoint_view<false>;
+using valid_codepoint_view = basic_codepoint_view<true>;
+
+#endif
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+/// @brief the bytes of a string literal, so it can be a template argument.
+template <size_t N>
+struct fixed_string {
+    utf8_t bytes[N] = {};
+
+    constexpr fixed_string(const char (&str)[N]) {
+        for (size_t i = 0; i < N; i++) bytes[i] = static_cast<utf8_t>(str[i]);
+    }
+#ifdef __cpp_char8_t
+    constexpr fixed_string(const char8_t (&str)[N]) {
+        for (size_t i = 0; i < N; i++) bytes[i] = static_cast<utf8_t>(str[i]);
+    }
+#endif
+
+    /// @return the length in bytes, without the null terminator.
+    constexpr size_t size() const { return N - 1; }
+};
+
+/// @brief a string literal checked at compile time, e.g. `utf8_literal<"héllo">`, which fails to compile if it isn't valid utf8.
+/// Its length and number of characters are worked out at compile time too, so none of it is repeated at runtime.
+template <fixed_string S>
+struct utf8_literal {
+    static_assert(utf8::is_valid_string(S.bytes, S.size()), "utf8_literal is not valid utf8");
+
+    // length in bytes, without the null terminator.
+    static constexpr size_t len = S.size();
+    // number of characters.
+    static constexpr size_t count = utf8::count(S.bytes, S.size());
+
+    /// @return pointer to the null terminated string.
+    static constexpr const utf8_t* data() { return S.bytes; }
+};
+
+inline namespace literals {
+
+/// @brief `"héllo"_utf8`, the same as `utf8_literal<"héllo">{}`.
+template <fixed_string S>
+constexpr utf8_literal<S> operator""_utf8() {
+    return {};
+}
+
+} // namespace literals
+
+#endif
+
+#if __cplusplus >= 202002L
+
+/// @brief a string known to be valid utf8, which can only be made by validating it, or from a `utf8_literal`.
+/// Functions that take one never need to check it again, and its `codepoints` skip the checks for malformed bytes.
+/// It doesn't own the string, like `std::string_view`.
+class validated_utf8 {
+public:
+    /// @brief the empty string.
+    constexpr validated_utf8() = default;
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+    /// @brief a literal was checked when it was compiled.
+    template <fixed_string S>
+    constexpr validated_utf8(utf8_literal<S> literal)
+        : str_(literal.data()), len_(literal.len) {}
+#endif
+
+    /// @brief checks the string with `utf8_is_valid_string64`, or `utf8::is_valid_string` at compile time.
+    /// @param str pointer to the string
+    /// @param len length of the string in bytes
+    /// @return the validated string, or nothing if it isn't valid utf8.
+    static constexpr std::optional<validated_utf8> validate(const utf8_t* str, size_t len) {
+        bool valid = std::is_constant_evaluated() ? is_valid_string(str, len) : utf8_is_valid_string64(str, len);
+        if (!valid) return std::nullopt;
+        return validated_utf8(str, len);
+    }
+
+    /// @brief `std::string_view` version of `validate`.
+    static std::optional<validated_utf8> validate(std::string_view str) {
+        return validate(reinterpret_cast<const utf8_t*>(str.data()), str.size());
+    }
+
+    constexpr const utf8_t* data() const { return str_; }
+    constexpr size_t size() const { return len_; }
+    constexpr bool empty() const { return len_ == 0; }
+
+    std::string_view view() const { return std::string_view(reinterpret_cast<const char*>(str_), len_); }
+
+    /// @brief the codepoints of the string, without checking for malformed bytes.
+    constexpr valid_codepoint_view codepoints() const { return valid_codepoint_view(str_, len_); }
+
+private:
+    constexpr validated_utf8(const utf8_t* str, size_t len) : str_(str), len_(len) {}
+
+    const utf8_t* str_ = nullptr;
+    size_t len_ = 0;
+};
+
+#endif
+
+} // namespace utf8
+
+#if __cplusplus >= 202002L
+// the views don't own the string, so their iterators can outlive them.
+template <bool Valid>
+inline constexpr bool std::ranges::enable_borrowed_range<utf8::basic_codepoint_view<Valid>> = true;
+#endif
+
+#endif // UTF8_HPP